@@ -42,430 +42,4540 @@ struct DFA {
 
 #endif
 
-//compares state with first element in a set of equivalent states
-bool equivalentWithSet(State state, const std::set<State> & set, std::map<State, State> & map, DFA & automaton) {
-    State first = *set.begin();
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
-    if (state == first) {
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//marks a missing transition in the dense transition tables
+const State NO_STATE = std::numeric_limits<State>::max();
+//marks a symbol which is not part of the alphabet
+const uint16_t NO_COLUMN = std::numeric_limits<uint16_t>::max();
+
+//alphabet shared by all dense automata taking part in one operation.
+//every symbol is assigned a column in the transition tables. Symbols with identical transitions
+//in all the automata may share a column (a symbol class), the column then only stores the transitions
+//of its representative, which is the smallest symbol of the class
+struct DenseAlphabet {
+    std::vector<Symbol> m_Symbols;
+    std::vector<Symbol> m_Representatives;
+    std::array<uint16_t, 256> m_Column;
+
+    size_t columns() const {
+        return m_Representatives.size();
+    }
+
+    Symbol symbol(size_t column) const {
+        return m_Representatives[column];
+    }
+};
+
+//alphabet with one column per symbol
+DenseAlphabet makeAlphabet(const std::set<Symbol> & symbols) {
+    DenseAlphabet result;
+    result.m_Symbols.assign(symbols.begin(), symbols.end());
+    result.m_Representatives = result.m_Symbols;
+    result.m_Column.fill(NO_COLUMN);
+
+    for (size_t i = 0; i < result.m_Symbols.size(); i++) {
+        result.m_Column[result.m_Symbols[i]] = i;
+    }
+
+    return result;
+}
+
+//partition of an alphabet into classes of symbols which have the same targets from every state of every
+//automaton added by refine(). Each state refines the classes separately: the symbols of a class which have
+//transitions from the state are grouped by their targets, and every group not covering the whole class is split off
+class SymbolClasses {
+public:
+    explicit SymbolClasses(const std::set<Symbol> & symbols)
+            : m_Symbols(symbols) {
+        m_Class.fill(NO_COLUMN);
+        for (auto symbol : symbols) {
+            m_Class[symbol] = 0;
+        }
+        m_Sizes.push_back(symbols.size());
+    }
+
+    template <typename Target>
+    void refine(const std::map<std::pair<State, Symbol>, Target> & transitions) {
+        std::vector<std::pair<Symbol, const Target *>> present;
+
+        for (auto transition = transitions.begin(); transition != transitions.end();) {
+            State state = transition->first.first;
+            present.clear();
+            for (; transition != transitions.end() && transition->first.first == state; ++transition) {
+                if (m_Class[transition->first.second] != NO_COLUMN) {
+                    present.emplace_back(transition->first.second, &transition->second);
+                }
+            }
+            split(present);
+        }
+    }
+
+    DenseAlphabet alphabet() const {
+        DenseAlphabet result;
+        result.m_Symbols.assign(m_Symbols.begin(), m_Symbols.end());
+        result.m_Column.fill(NO_COLUMN);
+
+        //columns are numbered in the order of the smallest symbols of the classes
+        std::vector<uint16_t> column(m_Sizes.size(), NO_COLUMN);
+        for (auto symbol : m_Symbols) {
+            uint16_t & id = column[m_Class[symbol]];
+            if (id == NO_COLUMN) {
+                id = result.m_Representatives.size();
+                result.m_Representatives.push_back(symbol);
+            }
+            result.m_Column[symbol] = id;
+        }
+
+        return result;
+    }
+
+private:
+    template <typename Target>
+    void split(std::vector<std::pair<Symbol, const Target *>> & present) {
+        std::sort(present.begin(), present.end(), [&](const auto & x, const auto & y) {
+            if (m_Class[x.first] != m_Class[y.first]) {
+                return m_Class[x.first] < m_Class[y.first];
+            }
+            return *x.second < *y.second;
+        });
+
+        for (size_t first = 0, last; first < present.size(); first = last) {
+            uint16_t group = m_Class[present[first].first];
+            for (last = first + 1; last < present.size() && m_Class[present[last].first] == group
+                                   && *present[last].second == *present[first].second; last++) {
+            }
+            if (last - first == m_Sizes[group]) {
+                continue;
+            }
+
+            uint16_t added = m_Sizes.size();
+            m_Sizes.push_back(last - first);
+            m_Sizes[group] -= last - first;
+            for (size_t i = first; i < last; i++) {
+                m_Class[present[i].first] = added;
+            }
+        }
+    }
+
+    std::set<Symbol> m_Symbols;
+    std::array<uint16_t, 256> m_Class;
+    std::vector<size_t> m_Sizes;
+};
+
+template <typename Automaton>
+const Automaton & automatonOf(const Automaton & automaton) {
+    return automaton;
+}
+
+template <typename Automaton>
+const Automaton & automatonOf(const Automaton * automaton) {
+    return *automaton;
+}
+
+//common alphabet of a range of automata (NFAs or DFAs) or of pointers to them, symbols share a column only if
+//they behave identically in all of the automata
+template <typename Range>
+DenseAlphabet compressedAlphabet(const Range & automata) {
+    std::set<Symbol> symbols;
+    for (auto & automaton : automata) {
+        symbols.insert(automatonOf(automaton).m_Alphabet.begin(), automatonOf(automaton).m_Alphabet.end());
+    }
+    SymbolClasses classes(symbols);
+    for (auto & automaton : automata) {
+        classes.refine(automatonOf(automaton).m_Transitions);
+    }
+    return classes.alphabet();
+}
+
+template <typename Automaton>
+DenseAlphabet compressedAlphabet(const Automaton & a, const Automaton & b) {
+    return compressedAlphabet(std::array<const Automaton *, 2>{&a, &b});
+}
+
+enum class MinimizationAlgorithm {
+    //Moore's round based refinement, O(n^2 * k) in the worst case
+    Moore,
+    //Hopcroft's refinement with a worklist of splitters, O(n * k * log n)
+    Hopcroft,
+};
+
+enum class IntersectionMode {
+    //determinize both operands completely, then build the product of the two DFAs
+    Eager,
+    //explore the product of the two subset constructions, creating only subset pairs reachable from the initial pair.
+    //it runs on one thread, so with more threads intersect() uses Eager
+    OnTheFly,
+};
+
+//boolean operation on the languages of two automata. The value of each operation is its truth table over the
+//finality of a pair of states, bit (2 * finalA + finalB) is set iff the pair is final
+enum class BooleanOperation : uint8_t {
+    Union = 0b1110,
+    Intersection = 0b1000,
+    //words of the first language which are not in the second one
+    Difference = 0b0100,
+    SymmetricDifference = 0b0110,
+    //words which are in the second language or not in the first one
+    Implication = 0b1011,
+};
+
+bool combineFinality(BooleanOperation operation, bool finalA, bool finalB) {
+    return (uint8_t(operation) >> (2 * finalA + finalB)) & 1;
+}
+
+//statistics of one conversion. They are only collected when compiled with AUTOMATA_STATS,
+//otherwise all the fields stay zero and the collection compiles to nothing
+struct ConversionStats {
+    //subsets of NFA states created by subset construction (eager or on the fly)
+    size_t m_SubsetsCreated = 0;
+    //pairs of states created by product constructions
+    size_t m_PairsExplored = 0;
+    //rounds of Moore's refinement, or splitters processed by Hopcroft's
+    size_t m_RefinementRounds = 0;
+    //blocks created by splitting during refinement
+    size_t m_Splits = 0;
+    //sink states removed from minimized automata
+    size_t m_SinkRemovals = 0;
+    //unreachable states and states which cannot reach a final state, removed by trimming
+    size_t m_TrimmedStates = 0;
+    //wall time spent in every phase, summed over all calls
+    double m_UnifySeconds = 0;
+    double m_DetermineSeconds = 0;
+    double m_ProductSeconds = 0;
+    double m_MinimizeSeconds = 0;
+    //largest number of bytes held by the tables of one phase
+    size_t m_PeakBytes = 0;
+
+    //accumulates the statistics of a conversion which ran separately, e.g. on another thread
+    void add(const ConversionStats & other) {
+        m_SubsetsCreated += other.m_SubsetsCreated;
+        m_PairsExplored += other.m_PairsExplored;
+        m_RefinementRounds += other.m_RefinementRounds;
+        m_Splits += other.m_Splits;
+        m_SinkRemovals += other.m_SinkRemovals;
+        m_TrimmedStates += other.m_TrimmedStates;
+        m_UnifySeconds += other.m_UnifySeconds;
+        m_DetermineSeconds += other.m_DetermineSeconds;
+        m_ProductSeconds += other.m_ProductSeconds;
+        m_MinimizeSeconds += other.m_MinimizeSeconds;
+        m_PeakBytes = std::max(m_PeakBytes, other.m_PeakBytes);
+    }
+};
+
+#ifdef AUTOMATA_STATS
+
+//adds the wall time of its scope to one of the time fields
+class PhaseTimer {
+public:
+    PhaseTimer(ConversionStats * stats, double ConversionStats::* field)
+            : m_Stats(stats),
+              m_Field(field),
+              m_Start(std::chrono::steady_clock::now()) {
+    }
+
+    ~PhaseTimer() {
+        if (m_Stats) {
+            m_Stats->*m_Field += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+        }
+    }
+
+private:
+    ConversionStats * m_Stats;
+    double ConversionStats::* m_Field;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+#define STATS_ADD(options, field, value) \
+    do { if ((options).m_Stats) { (options).m_Stats->field += (value); } } while (false)
+#define STATS_PEAK(options, bytes) \
+    do { if ((options).m_Stats) { (options).m_Stats->m_PeakBytes = std::max((options).m_Stats->m_PeakBytes, size_t(bytes)); } } while (false)
+#define STATS_TIMER(options, field) PhaseTimer phaseTimer((options).m_Stats, &ConversionStats::field)
+
+#else
+
+#define STATS_ADD(options, field, value) (void) (options)
+#define STATS_PEAK(options, bytes) (void) (options)
+#define STATS_TIMER(options, field) (void) (options)
+
+#endif
+
+enum class ConversionStatus {
+    Completed,
+    StateLimitExceeded,
+    MemoryLimitExceeded,
+    DeadlineExceeded,
+    Cancelled,
+};
+
+//resource limits of one conversion. Zero limits, no deadline and no cancellation token mean unlimited
+struct ConversionBudget {
+    //states created by one phase (subsets, pairs or DFA states)
+    size_t m_MaxStates = 0;
+    //bytes held by the tables of one phase
+    size_t m_MaxBytes = 0;
+    std::optional<std::chrono::steady_clock::time_point> m_Deadline;
+    //the conversion stops soon after the token is set
+    const std::atomic<bool> * m_Cancel = nullptr;
+};
+
+//thrown from the hot loops when the budget is exceeded, caught by the budgeted conversions
+struct BudgetExceeded : std::exception {
+    BudgetExceeded(ConversionStatus status, size_t states, size_t bytes)
+            : m_Status(status),
+              m_States(states),
+              m_Bytes(bytes) {
+    }
+
+    const char * what() const noexcept override {
+        return "conversion budget exceeded";
+    }
+
+    ConversionStatus m_Status;
+    size_t m_States;
+    size_t m_Bytes;
+};
+
+//checks a budget from a hot loop. Limits are checked on every call, the clock and the cancellation token
+//only on every CHECK_INTERVAL-th call to keep the check cheap
+class BudgetGuard {
+public:
+    static constexpr unsigned CHECK_INTERVAL = 1024;
+
+    explicit BudgetGuard(const ConversionBudget & budget)
+            : m_Budget(budget) {
+    }
+
+    void check(size_t states, size_t bytes) {
+        if (m_Budget.m_MaxStates != 0 && states > m_Budget.m_MaxStates) {
+            throw BudgetExceeded(ConversionStatus::StateLimitExceeded, states, bytes);
+        }
+        if (m_Budget.m_MaxBytes != 0 && bytes > m_Budget.m_MaxBytes) {
+            throw BudgetExceeded(ConversionStatus::MemoryLimitExceeded, states, bytes);
+        }
+        if (m_Ticks++ % CHECK_INTERVAL != 0) {
+            return;
+        }
+        if (m_Budget.m_Cancel && m_Budget.m_Cancel->load(std::memory_order_relaxed)) {
+            throw BudgetExceeded(ConversionStatus::Cancelled, states, bytes);
+        }
+        if (m_Budget.m_Deadline && std::chrono::steady_clock::now() > *m_Budget.m_Deadline) {
+            throw BudgetExceeded(ConversionStatus::DeadlineExceeded, states, bytes);
+        }
+    }
+
+private:
+    const ConversionBudget & m_Budget;
+    unsigned m_Ticks = 0;
+};
+
+//options shared by all conversions
+struct ConversionOptions {
+    MinimizationAlgorithm m_Minimization = MinimizationAlgorithm::Hopcroft;
+    IntersectionMode m_Intersection = IntersectionMode::OnTheFly;
+    //number of threads used by the parallel algorithms, 0 means one per hardware thread
+    unsigned m_Threads = 1;
+    //filled in by the conversions if not null, see ConversionStats
+    ConversionStats * m_Stats = nullptr;
+    //enforced by all conversions, the budgeted ones report an exceeded budget as a status, the others throw BudgetExceeded
+    ConversionBudget m_Budget;
+
+    unsigned threads() const {
+        return m_Threads != 0 ? m_Threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+};
+
+//DFA with states renumbered to 0..n-1. Transitions are stored row-major in one table
+//(row = state, column = symbol), missing transitions are NO_STATE
+struct DenseDFA {
+    DenseAlphabet m_Alphabet;
+    State m_StateCount = 0;
+    std::vector<State> m_Table;
+    State m_InitialState = 0;
+    std::vector<uint8_t> m_Final;
+
+    size_t columns() const {
+        return m_Alphabet.columns();
+    }
+
+    State next(State state, size_t column) const {
+        return m_Table[state * columns() + column];
+    }
+
+    State & next(State state, size_t column) {
+        return m_Table[state * columns() + column];
+    }
+
+    size_t bytes() const {
+        return m_Table.capacity() * sizeof(State) + m_Final.capacity();
+    }
+
+    void reserve(State states) {
+        m_Table.reserve(size_t(states) * columns());
+        m_Final.reserve(states);
+    }
+
+    //appends a new state without any transitions and returns its ID
+    State addState(bool final) {
+        m_Table.resize(m_Table.size() + columns(), NO_STATE);
+        m_Final.push_back(final);
+        return m_StateCount++;
+    }
+};
+
+//default transformation of DenseNFA::addTargets, keeps the targets as they are
+struct SameTargets {
+    State operator()(State state) const {
+        return state;
+    }
+};
+
+//NFA with states renumbered to 0..n-1. Transitions are stored in CSR form: targets of state s on column c
+//are m_Targets[m_Offsets[s * columns + c] .. m_Offsets[s * columns + c + 1])
+struct DenseNFA {
+    DenseAlphabet m_Alphabet;
+    State m_StateCount = 0;
+    std::vector<uint32_t> m_Offsets;
+    std::vector<State> m_Targets;
+    State m_InitialState = 0;
+    std::vector<uint8_t> m_Final;
+
+    size_t columns() const {
+        return m_Alphabet.columns();
+    }
+
+    size_t bytes() const {
+        return m_Offsets.capacity() * sizeof(uint32_t) + m_Targets.capacity() * sizeof(State) + m_Final.capacity();
+    }
+
+    const State * begin(State state, size_t column) const {
+        return m_Targets.data() + m_Offsets[state * columns() + column];
+    }
+
+    const State * end(State state, size_t column) const {
+        return m_Targets.data() + m_Offsets[state * columns() + column + 1];
+    }
+
+    void reserve(State states, size_t transitions) {
+        m_Offsets.reserve(size_t(states) * columns() + 1);
+        m_Targets.reserve(transitions);
+        m_Final.reserve(states);
+    }
+
+    //appends a new state without any transitions and returns its ID.
+    //transitions can only be added to the last state, see addTargets
+    State addState(bool final) {
+        if (m_Offsets.empty()) {
+            m_Offsets.push_back(0);
+        }
+        m_Offsets.resize(m_Offsets.size() + columns(), m_Targets.size());
+        m_Final.push_back(final);
+        return m_StateCount++;
+    }
+
+    //appends targets to a column of the last state, the columns have to be filled in increasing order
+    template <typename Iterator, typename Transform = SameTargets>
+    void addTargets(size_t column, Iterator begin, Iterator end, Transform transform = {}) {
+        for (; begin != end; ++begin) {
+            m_Targets.push_back(transform(*begin));
+        }
+        for (size_t row = (m_StateCount - 1) * columns() + column + 1; row < m_Offsets.size(); row++) {
+            m_Offsets[row] = m_Targets.size();
+        }
+    }
+};
+
+//maps the (possibly sparse) state IDs of an NFA or DFA onto 0..n-1
+class StateIndex {
+public:
+    explicit StateIndex(const std::set<State> & states)
+            : m_States(states.begin(), states.end()),
+              m_Identity(states.empty() || *states.rbegin() == states.size() - 1) {
+    }
+
+    State operator()(State state) const {
+        if (m_Identity) {
+            return state;
+        }
+        return std::lower_bound(m_States.begin(), m_States.end(), state) - m_States.begin();
+    }
+
+private:
+    std::vector<State> m_States;
+    bool m_Identity;
+};
+
+DenseNFA toDense(const NFA & nfa, const DenseAlphabet & alphabet) {
+    DenseNFA result;
+    StateIndex index(nfa.m_States);
+    size_t columns = alphabet.columns();
+
+    result.m_Alphabet = alphabet;
+    result.m_StateCount = nfa.m_States.size();
+    result.m_InitialState = index(nfa.m_InitialState);
+    result.m_Final.assign(result.m_StateCount, false);
+    for (auto state : nfa.m_FinalStates) {
+        result.m_Final[index(state)] = true;
+    }
+
+    //count targets of every row first, then turn the counts into offsets and fill the rows in place
+    //the other symbols of a class have the same transitions as its representative
+    //transitions on symbols outside of the alphabet are ignored
+    result.m_Offsets.assign(result.m_StateCount * columns + 1, 0);
+    for (auto & transition : nfa.m_Transitions) {
+        uint16_t column = alphabet.m_Column[transition.first.second];
+        if (column == NO_COLUMN) {
+            continue;
+        }
+        if (alphabet.symbol(column) == transition.first.second) {
+            result.m_Offsets[index(transition.first.first) * columns + column + 1] += transition.second.size();
+        }
+    }
+    std::partial_sum(result.m_Offsets.begin(), result.m_Offsets.end(), result.m_Offsets.begin());
+
+    result.m_Targets.resize(result.m_Offsets.back());
+    for (auto & transition : nfa.m_Transitions) {
+        uint16_t column = alphabet.m_Column[transition.first.second];
+        if (column == NO_COLUMN || alphabet.symbol(column) != transition.first.second) {
+            continue;
+        }
+        State * out = result.m_Targets.data() + result.m_Offsets[index(transition.first.first) * columns + column];
+        for (auto target : transition.second) {
+            *out++ = index(target);
+        }
+    }
+
+    return result;
+}
+
+DenseNFA toDense(const NFA & nfa) {
+    return toDense(nfa, compressedAlphabet(std::array<const NFA *, 1>{&nfa}));
+}
+
+DenseDFA toDense(const DFA & dfa, const DenseAlphabet & alphabet) {
+    DenseDFA result;
+    StateIndex index(dfa.m_States);
+
+    result.m_Alphabet = alphabet;
+    result.m_StateCount = dfa.m_States.size();
+    result.m_InitialState = index(dfa.m_InitialState);
+    result.m_Table.assign(result.m_StateCount * alphabet.columns(), NO_STATE);
+    result.m_Final.assign(result.m_StateCount, false);
+    for (auto state : dfa.m_FinalStates) {
+        result.m_Final[index(state)] = true;
+    }
+
+    for (auto & transition : dfa.m_Transitions) {
+        uint16_t column = alphabet.m_Column[transition.first.second];
+        if (column == NO_COLUMN) {
+            continue;
+        }
+        if (alphabet.symbol(column) == transition.first.second) {
+            result.next(index(transition.first.first), column) = index(transition.second);
+        }
+    }
+
+    return result;
+}
+
+DenseDFA toDense(const DFA & dfa) {
+    return toDense(dfa, compressedAlphabet(std::array<const DFA *, 1>{&dfa}));
+}
+
+NFA fromDense(const DenseNFA & dense) {
+    NFA result;
+    result.m_Alphabet.insert(dense.m_Alphabet.m_Symbols.begin(), dense.m_Alphabet.m_Symbols.end());
+    result.m_InitialState = dense.m_InitialState;
+
+    for (State state = 0; state < dense.m_StateCount; state++) {
+        result.m_States.insert(result.m_States.end(), state);
+        if (dense.m_Final[state]) {
+            result.m_FinalStates.insert(result.m_FinalStates.end(), state);
+        }
+
+        for (auto symbol : dense.m_Alphabet.m_Symbols) {
+            uint16_t column = dense.m_Alphabet.m_Column[symbol];
+            if (dense.begin(state, column) != dense.end(state, column)) {
+                result.m_Transitions.emplace_hint(result.m_Transitions.end(), std::make_pair(state, symbol),
+                                                  std::set<State>(dense.begin(state, column), dense.end(state, column)));
+            }
+        }
+    }
+
+    return result;
+}
+
+DFA fromDense(const DenseDFA & dense) {
+    DFA result;
+    result.m_Alphabet.insert(dense.m_Alphabet.m_Symbols.begin(), dense.m_Alphabet.m_Symbols.end());
+    result.m_InitialState = dense.m_InitialState;
+
+    for (State state = 0; state < dense.m_StateCount; state++) {
+        result.m_States.insert(result.m_States.end(), state);
+        if (dense.m_Final[state]) {
+            result.m_FinalStates.insert(result.m_FinalStates.end(), state);
+        }
+
+        for (auto symbol : dense.m_Alphabet.m_Symbols) {
+            State target = dense.next(state, dense.m_Alphabet.m_Column[symbol]);
+            if (target != NO_STATE) {
+                result.m_Transitions.emplace_hint(result.m_Transitions.end(), std::make_pair(state, symbol), target);
+            }
+        }
+    }
+
+    return result;
+}
+
+//routes every missing transition into an added sink state, so that every state has a transition for every column
+DenseDFA complete(DenseDFA dfa) {
+    if (std::find(dfa.m_Table.begin(), dfa.m_Table.end(), NO_STATE) == dfa.m_Table.end() && dfa.m_StateCount != 0) {
+        return dfa;
+    }
+
+    State sink = dfa.addState(false);
+    for (auto & target : dfa.m_Table) {
+        if (target == NO_STATE) {
+            target = sink;
+        }
+    }
+
+    return dfa;
+}
+
+//searches the graph of the given edges from the states marked in `reached`, marking every state found
+template <typename Edges>
+void markReachable(std::vector<uint8_t> & reached, Edges edges) {
+    std::vector<State> stack;
+    for (State state = 0; state < reached.size(); state++) {
+        if (reached[state]) {
+            stack.push_back(state);
+        }
+    }
+    while (!stack.empty()) {
+        State state = stack.back();
+        stack.pop_back();
+        edges(state, [&](State next) {
+            if (!reached[next]) {
+                reached[next] = true;
+                stack.push_back(next);
+            }
+        });
+    }
+}
+
+//reverse edges of a transition graph in CSR form: sources of state t are m_Sources[m_Offsets[t] .. m_Offsets[t + 1])
+struct ReverseEdges {
+    std::vector<uint32_t> m_Offsets;
+    std::vector<State> m_Sources;
+
+    //forEach(state, visit) calls visit(target) for every transition of the state
+    template <typename ForEach>
+    ReverseEdges(State states, ForEach forEach)
+            : m_Offsets(states + 1, 0) {
+        for (State state = 0; state < states; state++) {
+            forEach(state, [&](State target) {
+                m_Offsets[target + 1]++;
+            });
+        }
+        std::partial_sum(m_Offsets.begin(), m_Offsets.end(), m_Offsets.begin());
+
+        m_Sources.resize(m_Offsets[states]);
+        std::vector<uint32_t> cursor(m_Offsets.begin(), m_Offsets.end() - 1);
+        for (State state = 0; state < states; state++) {
+            forEach(state, [&](State target) {
+                m_Sources[cursor[target]++] = state;
+            });
+        }
+    }
+
+    template <typename Visit>
+    void operator()(State state, Visit visit) const {
+        for (uint32_t i = m_Offsets[state]; i < m_Offsets[state + 1]; i++) {
+            visit(m_Sources[i]);
+        }
+    }
+};
+
+//calls visit(target) for every transition of a DFA state
+auto dfaEdges(const DenseDFA & dfa) {
+    return [&dfa](State state, auto visit) {
+        for (size_t column = 0; column < dfa.columns(); column++) {
+            if (dfa.next(state, column) != NO_STATE) {
+                visit(dfa.next(state, column));
+            }
+        }
+    };
+}
+
+auto nfaEdges(const DenseNFA & nfa) {
+    return [&nfa](State state, auto visit) {
+        const State * begin = nfa.m_Targets.data() + nfa.m_Offsets[state * nfa.columns()];
+        const State * end = nfa.m_Targets.data() + nfa.m_Offsets[(state + 1) * nfa.columns()];
+        for (auto target = begin; target != end; target++) {
+            visit(*target);
+        }
+    };
+}
+
+//states reachable from the initial state
+template <typename Automaton, typename Edges>
+std::vector<uint8_t> accessibleStates(const Automaton & automaton, Edges edges) {
+    std::vector<uint8_t> result(automaton.m_StateCount, false);
+    if (automaton.m_StateCount != 0) {
+        result[automaton.m_InitialState] = true;
+    }
+    markReachable(result, edges);
+    return result;
+}
+
+//states from which a final state is reachable, found by a backward search from the final states
+template <typename Automaton, typename Edges>
+std::vector<uint8_t> coaccessibleStates(const Automaton & automaton, Edges edges) {
+    std::vector<uint8_t> result(automaton.m_Final);
+    markReachable(result, ReverseEdges(automaton.m_StateCount, edges));
+    return result;
+}
+
+std::vector<uint8_t> coaccessibleStates(const DenseDFA & dfa) {
+    return coaccessibleStates(dfa, dfaEdges(dfa));
+}
+
+//states which are both accessible and co-accessible, and the new IDs of these states (NO_STATE for the others).
+//the relative order of the states is kept
+template <typename Automaton, typename Edges>
+std::pair<std::vector<State>, State> usefulStates(const Automaton & automaton, Edges edges) {
+    std::vector<uint8_t> accessible = accessibleStates(automaton, edges);
+    std::vector<uint8_t> coaccessible = coaccessibleStates(automaton, edges);
+    std::vector<State> rename(automaton.m_StateCount, NO_STATE);
+    State count = 0;
+    for (State state = 0; state < automaton.m_StateCount; state++) {
+        if (accessible[state] && coaccessible[state]) {
+            rename[state] = count++;
+        }
+    }
+    return {rename, count};
+}
+
+DenseDFA keepStates(const DenseDFA & dfa, const std::vector<State> & rename, State count) {
+    DenseDFA result;
+    result.m_Alphabet = dfa.m_Alphabet;
+    if (count == 0) {
+        result.addState(false);
+        return result;
+    }
+
+    result.reserve(count);
+    for (State state = 0; state < dfa.m_StateCount; state++) {
+        if (rename[state] == NO_STATE) {
+            continue;
+        }
+        State added = result.addState(dfa.m_Final[state]);
+        for (size_t column = 0; column < dfa.columns(); column++) {
+            State target = dfa.next(state, column);
+            result.next(added, column) = target != NO_STATE ? rename[target] : NO_STATE;
+        }
+    }
+    result.m_InitialState = rename[dfa.m_InitialState];
+    return result;
+}
+
+//removes the states which are unreachable or cannot reach a final state, in linear time.
+//if the language is empty, the result is a single non-final state without transitions
+DenseDFA trim(const DenseDFA & dfa, const ConversionOptions & options = {}) {
+    auto [rename, count] = usefulStates(dfa, dfaEdges(dfa));
+    STATS_ADD(options, m_TrimmedStates, dfa.m_StateCount - count);
+    return keepStates(dfa, rename, count);
+}
+
+//consumes the DFA, it is returned as it is if all of its states are useful
+DenseDFA trim(DenseDFA && dfa, const ConversionOptions & options = {}) {
+    auto [rename, count] = usefulStates(dfa, dfaEdges(dfa));
+    STATS_ADD(options, m_TrimmedStates, dfa.m_StateCount - count);
+    if (count == dfa.m_StateCount) {
+        return std::move(dfa);
+    }
+    return keepStates(dfa, rename, count);
+}
+
+DenseNFA keepStates(const DenseNFA & nfa, const std::vector<State> & rename, State count) {
+    DenseNFA result;
+    result.m_Alphabet = nfa.m_Alphabet;
+    if (count == 0) {
+        result.addState(false);
+        return result;
+    }
+
+    std::vector<State> targets;
+    result.reserve(count, nfa.m_Targets.size());
+    for (State state = 0; state < nfa.m_StateCount; state++) {
+        if (rename[state] == NO_STATE) {
+            continue;
+        }
+        result.addState(nfa.m_Final[state]);
+        for (size_t column = 0; column < nfa.columns(); column++) {
+            targets.clear();
+            for (auto target = nfa.begin(state, column); target != nfa.end(state, column); target++) {
+                if (rename[*target] != NO_STATE) {
+                    targets.push_back(rename[*target]);
+                }
+            }
+            result.addTargets(column, targets.begin(), targets.end());
+        }
+    }
+    result.m_InitialState = rename[nfa.m_InitialState];
+    return result;
+}
+
+DenseNFA trim(const DenseNFA & nfa, const ConversionOptions & options = {}) {
+    auto [rename, count] = usefulStates(nfa, nfaEdges(nfa));
+    STATS_ADD(options, m_TrimmedStates, nfa.m_StateCount - count);
+    return keepStates(nfa, rename, count);
+}
+
+DenseNFA trim(DenseNFA && nfa, const ConversionOptions & options = {}) {
+    auto [rename, count] = usefulStates(nfa, nfaEdges(nfa));
+    STATS_ADD(options, m_TrimmedStates, nfa.m_StateCount - count);
+    if (count == nfa.m_StateCount) {
+        return std::move(nfa);
+    }
+    return keepStates(nfa, rename, count);
+}
+
+//renumbers blocks in order of their first state, so that a partition does not depend on how it was computed
+void normalizeBlocks(std::vector<State> & block) {
+    std::vector<State> rename(block.size(), NO_STATE);
+    State counter = 0;
+    for (auto & b : block) {
+        if (rename[b] == NO_STATE) {
+            rename[b] = counter++;
+        }
+        b = rename[b];
+    }
+}
+
+//number of distinct accept classes
+size_t countClasses(const std::vector<State> & classes) {
+    std::vector<State> sorted = classes;
+    std::sort(sorted.begin(), sorted.end());
+    return std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+}
+
+//Moore's partition refinement. Every round sorts the states by their block and the blocks of their successors
+//and splits blocks accordingly, until a round does not create any new block.
+//the initial blocks are the accept classes of the states.
+//returns the block of every state, blocks are numbered in order of their first state
+std::vector<State> moorePartition(const DenseDFA & dfa, const std::vector<State> & classes, const ConversionOptions & options) {
+    size_t columns = dfa.columns();
+    std::vector<State> block = classes;
+    std::vector<State> order(dfa.m_StateCount);
+    std::vector<State> nextBlock(dfa.m_StateCount);
+    size_t blockCount = countClasses(classes);
+
+    auto sameSignature = [&](State x, State y) {
+        if (block[x] != block[y]) {
+            return false;
+        }
+        for (size_t column = 0; column < columns; column++) {
+            if (block[dfa.next(x, column)] != block[dfa.next(y, column)]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    BudgetGuard guard(options.m_Budget);
+    while (true) {
+        guard.check(dfa.m_StateCount, dfa.bytes() + 3 * order.capacity() * sizeof(State));
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](State x, State y) {
+            if (block[x] != block[y]) {
+                return block[x] < block[y];
+            }
+            for (size_t column = 0; column < columns; column++) {
+                State bx = block[dfa.next(x, column)];
+                State by = block[dfa.next(y, column)];
+                if (bx != by) {
+                    return bx < by;
+                }
+            }
+            return x < y;
+        });
+
+        size_t newCount = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (i == 0 || !sameSignature(order[i - 1], order[i])) {
+                ++newCount;
+            }
+            nextBlock[order[i]] = newCount - 1;
+        }
+
+        block.swap(nextBlock);
+        STATS_ADD(options, m_RefinementRounds, 1);
+        if (newCount == blockCount) {
+            break;
+        }
+        STATS_ADD(options, m_Splits, newCount - blockCount);
+        blockCount = newCount;
+    }
+
+    normalizeBlocks(block);
+    return block;
+}
+
+//Hopcroft's partition refinement over the inverse transitions. Blocks are contiguous ranges of one array of states,
+//states of a block with a transition into the current splitter are swapped to the front of their block,
+//so splitting a block costs only the number of its marked states. The initial blocks are the accept classes of the states.
+//returns the block of every state, blocks are numbered in order of their first state
+std::vector<State> hopcroftPartition(const DenseDFA & dfa, const std::vector<State> & classes, const ConversionOptions & options) {
+    size_t columns = dfa.columns();
+    State n = dfa.m_StateCount;
+
+    //inverse transitions in CSR form, sources of state t on column c are stored in row c * n + t
+    std::vector<uint32_t> inverseOffsets(n * columns + 1, 0);
+    std::vector<State> inverse(n * columns);
+    for (State state = 0; state < n; state++) {
+        for (size_t column = 0; column < columns; column++) {
+            inverseOffsets[column * n + dfa.next(state, column) + 1]++;
+        }
+    }
+    std::partial_sum(inverseOffsets.begin(), inverseOffsets.end(), inverseOffsets.begin());
+
+    std::vector<uint32_t> cursor(inverseOffsets.begin(), inverseOffsets.end() - 1);
+    for (State state = 0; state < n; state++) {
+        for (size_t column = 0; column < columns; column++) {
+            inverse[cursor[column * n + dfa.next(state, column)]++] = state;
+        }
+    }
+
+    //refinable partition, block b holds elements[first[b] .. end[b]), the first marked[b] of them are marked
+    std::vector<State> elements(n);
+    std::vector<uint32_t> location(n);
+    std::vector<State> blockOf(n);
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> end;
+    std::vector<uint32_t> marked;
+    std::vector<uint8_t> inWorklist;
+    std::vector<State> worklist;
+    std::vector<State> touched;
+
+    auto addBlock = [&](uint32_t from, uint32_t to) {
+        first.push_back(from);
+        end.push_back(to);
+        marked.push_back(0);
+        inWorklist.push_back(false);
+        return State(first.size() - 1);
+    };
+
+    //initial partition: one block per accept class, in order of the classes
+    std::iota(elements.begin(), elements.end(), 0);
+    std::stable_sort(elements.begin(), elements.end(), [&](State x, State y) { return classes[x] < classes[y]; });
+    for (uint32_t i = 0; i < n; i++) {
+        location[elements[i]] = i;
+    }
+
+    std::vector<State> initialBlocks;
+    for (uint32_t from = 0, to = 0; from < n; from = to) {
+        while (to < n && classes[elements[to]] == classes[elements[from]]) {
+            to++;
+        }
+        initialBlocks.push_back(addBlock(from, to));
+    }
+    for (auto b : initialBlocks) {
+        for (uint32_t i = first[b]; i < end[b]; i++) {
+            blockOf[elements[i]] = b;
+        }
+    }
+
+    //every initial block but the largest one has to be used as a splitter
+    auto largest = std::max_element(initialBlocks.begin(), initialBlocks.end(), [&](State x, State y) {
+        return end[x] - first[x] < end[y] - first[y];
+    });
+    for (auto b = initialBlocks.begin(); b != initialBlocks.end(); b++) {
+        if (b != largest) {
+            worklist.push_back(*b);
+            inWorklist[*b] = true;
+        }
+    }
+
+    auto mark = [&](State state) {
+        State b = blockOf[state];
+        uint32_t position = location[state];
+        uint32_t destination = first[b] + marked[b];
+        if (position < destination) {
+            return;
+        }
+
+        std::swap(elements[position], elements[destination]);
+        location[elements[position]] = position;
+        location[elements[destination]] = destination;
+        if (marked[b]++ == 0) {
+            touched.push_back(b);
+        }
+    };
+
+    std::vector<State> splitter;
+    BudgetGuard guard(options.m_Budget);
+    size_t bytes = dfa.bytes() + (inverseOffsets.capacity() + inverse.capacity() + 6 * n) * sizeof(State);
+    while (!worklist.empty()) {
+        guard.check(n, bytes);
+        State current = worklist.back();
+        worklist.pop_back();
+        inWorklist[current] = false;
+        STATS_ADD(options, m_RefinementRounds, 1);
+
+        //the splitter itself may be split while processing its columns, so remember its states
+        splitter.assign(elements.begin() + first[current], elements.begin() + end[current]);
+
+        for (size_t column = 0; column < columns; column++) {
+            for (auto target : splitter) {
+                uint32_t row = column * n + target;
+                for (uint32_t i = inverseOffsets[row]; i < inverseOffsets[row + 1]; i++) {
+                    mark(inverse[i]);
+                }
+            }
+
+            for (auto b : touched) {
+                if (marked[b] == end[b] - first[b]) {
+                    marked[b] = 0;
+                    continue;
+                }
+
+                //marked states form a new block at the front of the old one
+                State created = addBlock(first[b], first[b] + marked[b]);
+                STATS_ADD(options, m_Splits, 1);
+                first[b] += marked[b];
+                marked[b] = 0;
+                for (uint32_t i = first[created]; i < end[created]; i++) {
+                    blockOf[elements[i]] = created;
+                }
+
+                if (inWorklist[b]) {
+                    worklist.push_back(created);
+                    inWorklist[created] = true;
+                }
+                else {
+                    State smaller = end[created] - first[created] <= end[b] - first[b] ? created : b;
+                    worklist.push_back(smaller);
+                    inWorklist[smaller] = true;
+                }
+            }
+            touched.clear();
+        }
+    }
+
+    STATS_PEAK(options, (inverseOffsets.capacity() + inverse.capacity() + 3 * n) * sizeof(State) + dfa.bytes());
+    normalizeBlocks(blockOf);
+    return blockOf;
+}
+
+//renumbers states in breadth-first order from the initial state, visiting successors in column order.
+//states which are not accessible keep their relative order after all accessible ones.
+//if given, the accept classes of the states are renumbered along
+DenseDFA canonicalize(const DenseDFA & dfa, std::vector<State> * classes = nullptr) {
+    size_t columns = dfa.columns();
+    std::vector<State> rename(dfa.m_StateCount, NO_STATE);
+    std::vector<State> order;
+    order.reserve(dfa.m_StateCount);
+
+    if (dfa.m_StateCount != 0) {
+        rename[dfa.m_InitialState] = 0;
+        order.push_back(dfa.m_InitialState);
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        for (size_t column = 0; column < columns; column++) {
+            State target = dfa.next(order[i], column);
+            if (target != NO_STATE && rename[target] == NO_STATE) {
+                rename[target] = order.size();
+                order.push_back(target);
+            }
+        }
+    }
+    for (State state = 0; state < dfa.m_StateCount; state++) {
+        if (rename[state] == NO_STATE) {
+            rename[state] = order.size();
+            order.push_back(state);
+        }
+    }
+
+    DenseDFA result;
+    result.m_Alphabet = dfa.m_Alphabet;
+    result.m_StateCount = dfa.m_StateCount;
+    result.m_InitialState = dfa.m_StateCount == 0 ? 0 : rename[dfa.m_InitialState];
+    result.m_Table.reserve(dfa.m_Table.size());
+    result.m_Final.reserve(dfa.m_StateCount);
+
+    for (auto state : order) {
+        result.m_Final.push_back(dfa.m_Final[state]);
+        for (size_t column = 0; column < columns; column++) {
+            State target = dfa.next(state, column);
+            result.m_Table.push_back(target == NO_STATE ? NO_STATE : rename[target]);
+        }
+    }
+
+    if (classes) {
+        std::vector<State> renamed(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            renamed[i] = (*classes)[order[i]];
+        }
+        classes->swap(renamed);
+    }
+
+    return result;
+}
+
+//minimal DFA in which only states of the same accept class can be merged, without the sink state.
+//classes[s] is the accept class of state s, 0 is the class of the non-final states. On return it holds
+//the classes of the states of the result. States are numbered canonically
+DenseDFA minimizeClasses(DenseDFA && original, std::vector<State> & classes, const ConversionOptions & options = {}) {
+    STATS_TIMER(options, m_MinimizeSeconds);
+    auto [rename, count] = usefulStates(original, dfaEdges(original));
+    STATS_ADD(options, m_TrimmedStates, original.m_StateCount - count);
+    std::vector<State> trimmedClasses(std::max<State>(count, 1), 0);
+    for (State state = 0; state < original.m_StateCount; state++) {
+        if (rename[state] != NO_STATE) {
+            trimmedClasses[rename[state]] = classes[state];
+        }
+    }
+    DenseDFA completed = count == original.m_StateCount ? std::move(original) : keepStates(original, rename, count);
+
+    State useful = completed.m_StateCount;
+    completed = complete(std::move(completed));
+    trimmedClasses.resize(completed.m_StateCount, 0);
+    std::vector<State> block = options.m_Minimization == MinimizationAlgorithm::Moore
+            ? moorePartition(completed, trimmedClasses, options)
+            : hopcroftPartition(completed, trimmedClasses, options);
+    size_t columns = completed.columns();
+
+    //after trimming, the sink added by complete() is the only state which cannot reach a final state.
+    //if the language is empty, the single state left by trimming is merged with it
+    State sink = completed.m_StateCount > useful ? block[useful] : NO_STATE;
+    if (sink == block[completed.m_InitialState]) {
+        DenseDFA empty;
+        empty.m_Alphabet = completed.m_Alphabet;
+        empty.addState(false);
+        classes.assign(1, 0);
+        return empty;
+    }
+
+    //build the quotient automaton without the sink, every other block becomes one state
+    if (sink != NO_STATE) {
+        STATS_ADD(options, m_SinkRemovals, 1);
+    }
+    auto quotient = [sink](State block) {
+        return block == sink ? NO_STATE : sink != NO_STATE && block > sink ? block - 1 : block;
+    };
+
+    DenseDFA result;
+    result.m_Alphabet = completed.m_Alphabet;
+    result.m_StateCount = *std::max_element(block.begin(), block.end()) + (sink == NO_STATE ? 1 : 0);
+    result.m_Table.assign(result.m_StateCount * columns, NO_STATE);
+    result.m_Final.assign(result.m_StateCount, false);
+    result.m_InitialState = quotient(block[completed.m_InitialState]);
+    classes.assign(result.m_StateCount, 0);
+
+    for (State state = 0; state < completed.m_StateCount; state++) {
+        State from = quotient(block[state]);
+        if (from == NO_STATE) {
+            continue;
+        }
+        result.m_Final[from] = trimmedClasses[state] != 0;
+        classes[from] = trimmedClasses[state];
+        for (size_t column = 0; column < columns; column++) {
+            result.next(from, column) = quotient(block[completed.next(state, column)]);
+        }
+    }
+
+    return canonicalize(result, &classes);
+}
+
+//minimal DFA accepting the same language, without the sink state. States are numbered canonically.
+//the original is consumed, a complete DFA is minimized without copying its table
+DenseDFA minimize(DenseDFA && original, const ConversionOptions & options = {}) {
+    std::vector<State> classes(original.m_Final.begin(), original.m_Final.end());
+    return minimizeClasses(std::move(original), classes, options);
+}
+
+DFA minimize(const DFA & original, const ConversionOptions & options = {}) {
+    return fromDense(minimize(toDense(original), options));
+}
+
+//consumes the DFA, its sets and maps are released as soon as it is converted to the dense form
+DFA minimize(DFA && original, const ConversionOptions & options = {}) {
+    DenseDFA dense = toDense(original);
+    original = DFA();
+    return fromDense(minimize(std::move(dense), options));
+}
+
+void minimizeInPlace(DFA & dfa, const ConversionOptions & options = {}) {
+    dfa = minimize(std::move(dfa), options);
+}
+
+//mixes the words of a bitset into one 64-bit hash
+uint64_t hashWords(const uint64_t * words, size_t count) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ count;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ words[i]) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+//subset of NFA states as a bitset of a fixed number of words which knows the range [first(), last()) of its
+//non-zero words, the first and the last word of the range are non-zero. Clearing, scanning, hashing and storing
+//a subset only touch that range, so the sparse subsets of a large NFA do not cost time proportional to its size
+class SubsetBuffer {
+public:
+    explicit SubsetBuffer(size_t words)
+            : m_Bits(words, 0) {
+    }
+
+    //all the words, the ones outside the range are zero
+    const uint64_t * data() const {
+        return m_Bits.data();
+    }
+
+    size_t first() const {
+        return m_First;
+    }
+
+    size_t last() const {
+        return m_Last;
+    }
+
+    bool empty() const {
+        return m_First == m_Last;
+    }
+
+    uint64_t hash() const {
+        return hashWords(m_Bits.data() + m_First, m_Last - m_First) ^ (m_First * 0xC2B2AE3D27D4EB4FULL);
+    }
+
+    void clear() {
+        std::fill(m_Bits.begin() + m_First, m_Bits.begin() + m_Last, 0);
+        m_First = m_Last = 0;
+    }
+
+    void set(State state) {
+        size_t word = state / 64;
+        m_Bits[word] |= uint64_t(1) << (state % 64);
+        extend(word, word + 1);
+    }
+
+    //ORs in the words [first, last) of another subset, range points to its word first
+    void unite(const uint64_t * range, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            m_Bits[i] |= range[i - first];
+        }
+        extend(first, last);
+    }
+
+    //replaces the contents by the subset with the non-zero words [first, last), range points to its word first
+    void assign(const uint64_t * range, size_t first, size_t last) {
+        clear();
+        std::copy(range, range + (last - first), m_Bits.begin() + first);
+        m_First = first;
+        m_Last = last;
+    }
+
+    //calls visit(state) for every state of the subset in increasing order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (size_t word = m_First; word < m_Last; word++) {
+            for (uint64_t bits = m_Bits[word]; bits != 0; bits &= bits - 1) {
+                visit(State(word * 64 + __builtin_ctzll(bits)));
+            }
+        }
+    }
+
+private:
+    void extend(size_t first, size_t last) {
+        if (first == last) {
+            return;
+        }
+        if (m_First == m_Last) {
+            m_First = first;
+            m_Last = last;
+        }
+        else {
+            m_First = std::min(m_First, first);
+            m_Last = std::max(m_Last, last);
+        }
+    }
+
+    std::vector<uint64_t> m_Bits;
+    size_t m_First = 0;
+    size_t m_Last = 0;
+};
+
+//computes successors of subsets of NFA states, subsets are SubsetBuffers of words() 64-bit words.
+//if it fits into the memory limit, the successor range of every (state, column) is precomputed,
+//so the successor of a subset is a word-parallel OR of the rows of its states
+class SubsetSuccessors {
+public:
+    static constexpr size_t PRECOMPUTED_LIMIT = 64 << 20;
+
+    explicit SubsetSuccessors(const DenseNFA & nfa)
+            : m_NFA(nfa),
+              m_Words((nfa.m_StateCount + 63) / 64),
+              m_FinalMask(m_Words, 0) {
+        for (State state = 0; state < nfa.m_StateCount; state++) {
+            if (nfa.m_Final[state]) {
+                m_FinalMask[state / 64] |= uint64_t(1) << (state % 64);
+            }
+        }
+
+        //a row holds the words from the one of the smallest target to the one of the largest
+        size_t columns = nfa.columns();
+        size_t rowWords = 0;
+        for (State state = 0; state < nfa.m_StateCount; state++) {
+            for (size_t column = 0; column < columns; column++) {
+                if (nfa.begin(state, column) != nfa.end(state, column)) {
+                    auto range = std::minmax_element(nfa.begin(state, column), nfa.end(state, column));
+                    rowWords += *range.second / 64 - *range.first / 64 + 1;
+                }
+            }
+        }
+        if (rowWords * sizeof(uint64_t) + nfa.m_StateCount * columns * sizeof(uint64_t) > PRECOMPUTED_LIMIT) {
+            return;
+        }
+
+        m_Rows.reserve(rowWords);
+        m_RowOffsets.reserve(nfa.m_StateCount * columns + 1);
+        m_RowFirsts.reserve(nfa.m_StateCount * columns);
+        m_RowOffsets.push_back(0);
+        SubsetBuffer row(m_Words);
+        for (State state = 0; state < nfa.m_StateCount; state++) {
+            for (size_t column = 0; column < columns; column++) {
+                row.clear();
+                for (auto target = nfa.begin(state, column); target != nfa.end(state, column); target++) {
+                    row.set(*target);
+                }
+                m_Rows.insert(m_Rows.end(), row.data() + row.first(), row.data() + row.last());
+                m_RowOffsets.push_back(m_Rows.size());
+                m_RowFirsts.push_back(row.first());
+            }
+        }
+    }
+
+    size_t words() const {
+        return m_Words;
+    }
+
+    size_t bytes() const {
+        return (m_FinalMask.capacity() + m_Rows.capacity()) * sizeof(uint64_t)
+               + m_RowOffsets.capacity() * sizeof(uint32_t) + m_RowFirsts.capacity() * sizeof(uint32_t);
+    }
+
+    void initial(SubsetBuffer & out) const {
+        out.clear();
+        out.set(m_NFA.m_InitialState);
+    }
+
+    bool isFinal(const SubsetBuffer & subset) const {
+        for (size_t i = subset.first(); i < subset.last(); i++) {
+            if (subset.data()[i] & m_FinalMask[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //unifies the transitions on the given column of all states in the subset
+    void successors(const SubsetBuffer & subset, size_t column, SubsetBuffer & out) const {
+        out.clear();
+        subset.forEach([&](State state) {
+            if (!m_RowOffsets.empty()) {
+                size_t row = state * m_NFA.columns() + column;
+                size_t first = m_RowFirsts[row];
+                out.unite(m_Rows.data() + m_RowOffsets[row], first, first + m_RowOffsets[row + 1] - m_RowOffsets[row]);
+            }
+            else {
+                for (auto target = m_NFA.begin(state, column); target != m_NFA.end(state, column); target++) {
+                    out.set(*target);
+                }
+            }
+        });
+    }
+
+private:
+    const DenseNFA & m_NFA;
+    size_t m_Words;
+    std::vector<uint64_t> m_FinalMask;
+    //precomputed rows stored back to back, row state * columns + column starts at word m_RowFirsts[row]
+    std::vector<uint64_t> m_Rows;
+    std::vector<uint32_t> m_RowOffsets;
+    std::vector<uint32_t> m_RowFirsts;
+};
+
+//interns subsets, giving every distinct subset a consecutive ID. Only the range of non-zero words of a subset
+//is stored, all of them back to back in one array, and looked up through an open-addressing hash table
+class SubsetTable {
+public:
+    SubsetTable()
+            : m_Slots(16, NO_STATE),
+              m_Offsets(1, 0) {
+    }
+
+    size_t size() const {
+        return m_Hashes.size();
+    }
+
+    //copies the subset with the given ID into out
+    void load(State id, SubsetBuffer & out) const {
+        out.assign(m_Storage.data() + m_Offsets[id], m_Firsts[id], last(id));
+    }
+
+    //whether the subset x is contained in the subset y
+    bool isSubsetOf(State x, State y) const {
+        if (m_Offsets[x] == m_Offsets[x + 1]) {
+            return true;
+        }
+        //the first and the last stored words are non-zero, so the range of x has to be within the range of y
+        if (m_Firsts[x] < m_Firsts[y] || last(x) > last(y)) {
+            return false;
+        }
+        const uint64_t * wordsX = m_Storage.data() + m_Offsets[x];
+        const uint64_t * wordsY = m_Storage.data() + m_Offsets[y] + (m_Firsts[x] - m_Firsts[y]);
+        for (size_t i = 0; i < m_Offsets[x + 1] - m_Offsets[x]; i++) {
+            if (wordsX[i] & ~wordsY[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t bytes() const {
+        return m_Slots.capacity() * sizeof(State) + m_Firsts.capacity() * sizeof(uint32_t)
+               + (m_Hashes.capacity() + m_Offsets.capacity() + m_Storage.capacity()) * sizeof(uint64_t);
+    }
+
+    //bytes taken by the subsets held now, memory kept for reuse by clear() is not counted
+    size_t usedBytes() const {
+        return size() * (2 * sizeof(State) + sizeof(uint32_t) + 2 * sizeof(uint64_t)) + m_Storage.size() * sizeof(uint64_t);
+    }
+
+    //returns the ID of the subset and whether it was added by this call
+    std::pair<State, bool> intern(const SubsetBuffer & subset) {
+        return intern(subset, subset.hash());
+    }
+
+    std::pair<State, bool> intern(const SubsetBuffer & subset, uint64_t hash) {
+        size_t mask = m_Slots.size() - 1;
+        const uint64_t * begin = subset.data() + subset.first();
+        const uint64_t * end = subset.data() + subset.last();
+
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            State id = m_Slots[slot];
+            if (id == NO_STATE) {
+                id = size();
+                m_Slots[slot] = id;
+                m_Hashes.push_back(hash);
+                m_Firsts.push_back(subset.first());
+                m_Storage.insert(m_Storage.end(), begin, end);
+                m_Offsets.push_back(m_Storage.size());
+                if (size() * 2 > m_Slots.size()) {
+                    grow();
+                }
+                return {id, true};
+            }
+            if (m_Hashes[id] == hash && m_Firsts[id] == subset.first() && last(id) == subset.last()
+                    && std::equal(begin, end, m_Storage.data() + m_Offsets[id])) {
+                return {id, false};
+            }
+        }
+    }
+
+    //forgets all subsets, the memory is kept for reuse
+    void clear() {
+        m_Slots.assign(16, NO_STATE);
+        m_Hashes.clear();
+        m_Firsts.clear();
+        m_Offsets.resize(1);
+        m_Storage.clear();
+    }
+
+private:
+    size_t last(State id) const {
+        return m_Firsts[id] + (m_Offsets[id + 1] - m_Offsets[id]);
+    }
+
+    void grow() {
+        m_Slots.assign(m_Slots.size() * 2, NO_STATE);
+        size_t mask = m_Slots.size() - 1;
+        for (State id = 0; id < size(); id++) {
+            size_t slot = m_Hashes[id] & mask;
+            while (m_Slots[slot] != NO_STATE) {
+                slot = (slot + 1) & mask;
+            }
+            m_Slots[slot] = id;
+        }
+    }
+
+    std::vector<State> m_Slots;
+    std::vector<uint64_t> m_Hashes;
+    //the non-zero words of subset id are m_Storage[m_Offsets[id] .. m_Offsets[id + 1]), the first is word m_Firsts[id]
+    std::vector<uint32_t> m_Firsts;
+    std::vector<uint64_t> m_Offsets;
+    std::vector<uint64_t> m_Storage;
+};
+
+//SubsetTable which can be shared by several threads. Subsets are distributed over independently locked shards
+//by their hash, IDs are handed out by one atomic counter, so they are consecutive but depend on thread timing
+class ConcurrentSubsetTable {
+public:
+    static constexpr size_t SHARDS = 64;
+
+    ConcurrentSubsetTable() {
+        for (auto & shard : m_Shards) {
+            shard = std::make_unique<Shard>();
+        }
+    }
+
+    //identifies an interned subset within its shard, see copy()
+    struct Handle {
+        uint32_t m_Shard;
+        State m_Index;
+    };
+
+    size_t size() const {
+        return m_Counter.load();
+    }
+
+    //number of words stored for all the subsets
+    size_t storedWords() const {
+        return m_StoredWords.load();
+    }
+
+    //returns the ID of the subset and whether it was added by this call, handle is set to where it is stored
+    std::pair<State, bool> intern(const SubsetBuffer & subset, Handle & handle) {
+        uint64_t hash = subset.hash();
+        handle.m_Shard = (hash >> 58) % SHARDS;
+        Shard & shard = *m_Shards[handle.m_Shard];
+        std::lock_guard<std::mutex> lock(shard.m_Mutex);
+
+        auto interned = shard.m_Table.intern(subset, hash);
+        if (interned.second) {
+            shard.m_IDs.push_back(m_Counter.fetch_add(1));
+            m_StoredWords.fetch_add(subset.last() - subset.first());
+        }
+        handle.m_Index = interned.first;
+        return {shard.m_IDs[interned.first], interned.second};
+    }
+
+    //copies an interned subset, the shard may reallocate its storage while others intern
+    void copy(Handle handle, SubsetBuffer & out) {
+        Shard & shard = *m_Shards[handle.m_Shard];
+        std::lock_guard<std::mutex> lock(shard.m_Mutex);
+        shard.m_Table.load(handle.m_Index, out);
+    }
+
+private:
+    struct Shard {
+        std::mutex m_Mutex;
+        SubsetTable m_Table;
+        std::vector<State> m_IDs;
+    };
+
+    std::atomic<State> m_Counter{0};
+    std::atomic<size_t> m_StoredWords{0};
+    std::array<std::unique_ptr<Shard>, SHARDS> m_Shards;
+};
+
+//runs tasks on a fixed number of threads until no task is left. Every worker owns a deque of tasks,
+//it pushes and pops its own tasks at the back and steals from the front of other deques when its own is empty.
+//if a task throws, the remaining tasks are dropped and the exception is rethrown from run()
+template <typename Task>
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads) {
+        for (unsigned i = 0; i < threads; i++) {
+            m_Queues.push_back(std::make_unique<Queue>());
+        }
+    }
+
+    //must only be called by the given worker (or before run())
+    void push(unsigned worker, Task && task) {
+        m_Pending.fetch_add(1);
+        std::lock_guard<std::mutex> lock(m_Queues[worker]->m_Mutex);
+        m_Queues[worker]->m_Tasks.push_back(std::move(task));
+    }
+
+    //body(Task &&, unsigned worker) is called for every task, it may push further tasks
+    template <typename Body>
+    void run(Body body) {
+        std::vector<std::thread> threads;
+        for (unsigned worker = 1; worker < m_Queues.size(); worker++) {
+            threads.emplace_back([this, &body, worker] { work(body, worker); });
+        }
+        work(body, 0);
+        for (auto & thread : threads) {
+            thread.join();
+        }
+
+        if (m_Exception) {
+            std::rethrow_exception(m_Exception);
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex m_Mutex;
+        std::deque<Task> m_Tasks;
+    };
+
+    std::optional<Task> take(unsigned worker) {
+        for (size_t i = 0; i < m_Queues.size(); i++) {
+            Queue & queue = *m_Queues[(worker + i) % m_Queues.size()];
+            std::lock_guard<std::mutex> lock(queue.m_Mutex);
+            if (queue.m_Tasks.empty()) {
+                continue;
+            }
+
+            std::optional<Task> task;
+            if (i == 0) {
+                task.emplace(std::move(queue.m_Tasks.back()));
+                queue.m_Tasks.pop_back();
+            }
+            else {
+                task.emplace(std::move(queue.m_Tasks.front()));
+                queue.m_Tasks.pop_front();
+            }
+            return task;
+        }
+        return std::nullopt;
+    }
+
+    template <typename Body>
+    void work(Body & body, unsigned worker) {
+        while (m_Pending.load() != 0 && !m_Failed.load()) {
+            std::optional<Task> task = take(worker);
+            if (!task) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            try {
+                body(std::move(*task), worker);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(m_ExceptionMutex);
+                if (!m_Exception) {
+                    m_Exception = std::current_exception();
+                }
+                m_Failed = true;
+            }
+            m_Pending.fetch_sub(1);
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+    std::atomic<size_t> m_Pending{0};
+    std::atomic<bool> m_Failed{false};
+    std::mutex m_ExceptionMutex;
+    std::exception_ptr m_Exception;
+};
+
+//calls body(i) for every i in [0, count) on the given number of threads, indices are handed out dynamically.
+//if a call throws, the remaining indices are skipped and the exception is rethrown
+template <typename Body>
+void parallelFor(size_t count, unsigned threads, Body body) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+
+    auto work = [&] {
+        for (size_t i = next.fetch_add(1); i < count && !failed.load(); i = next.fetch_add(1)) {
+            try {
+                body(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < std::min<size_t>(threads, count); i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto & worker : workers) {
+        worker.join();
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+//subset construction of an NFA computed on demand. Subsets are interned when they are first reached,
+//transitions are computed on their first use and cached. State 0 is the initial subset
+class LazyDeterminization {
+public:
+    explicit LazyDeterminization(const DenseNFA & nfa)
+            : m_Successors(nfa),
+              m_Columns(nfa.columns()),
+              m_Current(m_Successors.words()),
+              m_Buffer(m_Successors.words()) {
+        clear();
+    }
+
+    size_t size() const {
+        return m_Subsets.size();
+    }
+
+    size_t words() const {
+        return m_Successors.words();
+    }
+
+    size_t bytes() const {
+        return m_Subsets.bytes() + m_Table.capacity() * sizeof(State) + m_Final.capacity() + m_Empty.capacity();
+    }
+
+    //bytes taken by the subsets held now and their transitions, memory kept for reuse by clear() is not counted
+    size_t usedBytes() const {
+        return m_Subsets.usedBytes() + m_Table.size() * sizeof(State) + m_Final.size() + m_Empty.size();
+    }
+
+    const SubsetSuccessors & successors() const {
+        return m_Successors;
+    }
+
+    void subset(State state, SubsetBuffer & out) const {
+        m_Subsets.load(state, out);
+    }
+
+    //whether subset x is contained in subset y
+    bool isSubsetOf(State x, State y) const {
+        return m_Subsets.isSubsetOf(x, y);
+    }
+
+    bool isFinal(State state) const {
+        return m_Final[state];
+    }
+
+    //the empty subset can never reach a final state
+    bool isEmpty(State state) const {
+        return m_Empty[state];
+    }
+
+    //the transition if it was computed already, NO_STATE otherwise
+    State cached(State state, size_t column) const {
+        return m_Table[state * m_Columns + column];
+    }
+
+    State next(State state, size_t column) {
+        State & cached = m_Table[state * m_Columns + column];
+        if (cached == NO_STATE) {
+            //the subset table may reallocate while interning, so compute the successor from a copy
+            subset(state, m_Current);
+            m_Successors.successors(m_Current, column, m_Buffer);
+            State target = intern(m_Buffer);
+            m_Table[state * m_Columns + column] = target;
+            return target;
+        }
+        return cached;
+    }
+
+    //forgets all subsets but the initial one (always state 0) and the given one, whose new ID is returned.
+    //the memory is kept for reuse
+    State clear(State keep = NO_STATE) {
+        if (keep != NO_STATE) {
+            subset(keep, m_Current);
+        }
+
+        m_Subsets.clear();
+        m_Table.clear();
+        m_Final.clear();
+        m_Empty.clear();
+
+        m_Successors.initial(m_Buffer);
+        intern(m_Buffer);
+        return keep != NO_STATE ? intern(m_Current) : 0;
+    }
+
+private:
+    State intern(const SubsetBuffer & subset) {
+        auto interned = m_Subsets.intern(subset);
+        if (interned.second) {
+            m_Final.push_back(m_Successors.isFinal(subset));
+            m_Empty.push_back(subset.empty());
+            m_Table.resize(m_Table.size() + m_Columns, NO_STATE);
+        }
+        return interned.first;
+    }
+
+    SubsetSuccessors m_Successors;
+    SubsetTable m_Subsets;
+    size_t m_Columns;
+    SubsetBuffer m_Current;
+    SubsetBuffer m_Buffer;
+    std::vector<uint8_t> m_Final;
+    std::vector<uint8_t> m_Empty;
+    std::vector<State> m_Table;
+};
+
+//subset construction expanding the frontier on several threads. Newly interned subsets are pushed as tasks
+//of the worker which found them, idle workers steal. The resulting automaton is renumbered canonically,
+//which gives the same numbering as the sequential breadth-first construction
+DenseDFA determineParallel(const DenseNFA & nfa, const ConversionOptions & options) {
+    //the bits of a subset are read back from the table, so expanding a subset does not allocate
+    struct Task {
+        State m_ID;
+        ConcurrentSubsetTable::Handle m_Handle;
+    };
+
+    //rows of successor IDs expanded by one worker, in the order of m_IDs
+    struct Output {
+        std::vector<State> m_IDs;
+        std::vector<State> m_Rows;
+        std::vector<State> m_Final;
+    };
+
+    size_t columns = nfa.columns();
+    SubsetSuccessors successors(nfa);
+    ConcurrentSubsetTable subsets;
+    WorkStealingPool<Task> pool(options.threads());
+    std::vector<Output> outputs(options.threads());
+    std::vector<BudgetGuard> guards(options.threads(), BudgetGuard(options.m_Budget));
+    //per worker scratch: the subset being expanded and its successor
+    std::vector<SubsetBuffer> current(options.threads(), SubsetBuffer(successors.words()));
+    std::vector<SubsetBuffer> next(options.threads(), SubsetBuffer(successors.words()));
+    //bytes held per subset by the subset table and the output rows, besides the stored words
+    size_t bytesPerSubset = columns * sizeof(State) + 4 * sizeof(uint64_t);
+
+    Task initial{0, {}};
+    successors.initial(current[0]);
+    subsets.intern(current[0], initial.m_Handle);
+    if (successors.isFinal(current[0])) {
+        outputs[0].m_Final.push_back(0);
+    }
+    pool.push(0, std::move(initial));
+
+    pool.run([&](Task && task, unsigned worker) {
+        guards[worker].check(subsets.size(), subsets.size() * bytesPerSubset + subsets.storedWords() * sizeof(uint64_t)
+                                             + successors.bytes());
+        Output & output = outputs[worker];
+        output.m_IDs.push_back(task.m_ID);
+        subsets.copy(task.m_Handle, current[worker]);
+
+        for (size_t column = 0; column < columns; column++) {
+            successors.successors(current[worker], column, next[worker]);
+
+            ConcurrentSubsetTable::Handle handle;
+            auto interned = subsets.intern(next[worker], handle);
+            output.m_Rows.push_back(interned.first);
+            if (interned.second) {
+                if (successors.isFinal(next[worker])) {
+                    output.m_Final.push_back(interned.first);
+                }
+                pool.push(worker, Task{interned.first, handle});
+            }
+        }
+    });
+
+    DenseDFA result;
+    result.m_Alphabet = nfa.m_Alphabet;
+    result.m_InitialState = 0;
+    result.m_StateCount = subsets.size();
+    result.m_Table.resize(result.m_StateCount * columns);
+    result.m_Final.assign(result.m_StateCount, false);
+
+    for (auto & output : outputs) {
+        for (size_t i = 0; i < output.m_IDs.size(); i++) {
+            std::copy(output.m_Rows.begin() + i * columns, output.m_Rows.begin() + (i + 1) * columns,
+                      result.m_Table.begin() + output.m_IDs[i] * columns);
+        }
+        for (auto state : output.m_Final) {
+            result.m_Final[state] = true;
+        }
+    }
+
+    STATS_ADD(options, m_SubsetsCreated, result.m_StateCount);
+    STATS_PEAK(options, subsets.storedWords() * sizeof(uint64_t) + 2 * result.bytes());
+    return canonicalize(result);
+}
+
+//sequential subset construction starting from the given subset, only subsets reachable from it are created.
+//subsets are expanded in order of their IDs, so every subset is expanded exactly once.
+//isFinal(subset) is called once for every new subset, in order of the IDs, and decides whether its state is final
+template <typename IsFinal>
+DenseDFA subsetConstruction(const DenseNFA & nfa, const SubsetSuccessors & successors, const SubsetBuffer & initial,
+                            const ConversionOptions & options, IsFinal isFinal) {
+    DenseDFA result;
+    result.m_Alphabet = nfa.m_Alphabet;
+    result.m_InitialState = 0;
+    size_t columns = nfa.columns();
+
+    SubsetTable subsets;
+    SubsetBuffer current(successors.words());
+    SubsetBuffer tmp(successors.words());
+
+    subsets.intern(initial);
+    result.addState(isFinal(initial));
+
+    BudgetGuard guard(options.m_Budget);
+    for (State id = 0; id < subsets.size(); id++) {
+        guard.check(subsets.size(), subsets.bytes() + successors.bytes() + result.bytes());
+        //the table may reallocate while interning, so work on a copy of the subset
+        subsets.load(id, current);
+
+        for (size_t column = 0; column < columns; column++) {
+            successors.successors(current, column, tmp);
+
+            auto interned = subsets.intern(tmp);
+            if (interned.second) {
+                result.addState(isFinal(tmp));
+            }
+            result.next(id, column) = interned.first;
+        }
+    }
+
+    STATS_ADD(options, m_SubsetsCreated, subsets.size());
+    STATS_PEAK(options, subsets.bytes() + successors.bytes() + result.bytes());
+    return result;
+}
+
+//subset construction, only subsets reachable from the initial state are created.
+//the empty subset becomes the sink state, so the resulting DFA is complete
+DenseDFA determine(const DenseNFA & nfa, const ConversionOptions & options = {}) {
+    STATS_TIMER(options, m_DetermineSeconds);
+    if (options.threads() > 1) {
+        return determineParallel(nfa, options);
+    }
+
+    SubsetSuccessors successors(nfa);
+    SubsetBuffer initial(successors.words());
+    successors.initial(initial);
+    return subsetConstruction(nfa, successors, initial, options, [&](const SubsetBuffer & subset) {
+        return successors.isFinal(subset);
+    });
+}
+
+//removes unreachable states, adds sink state if necessary
+//states which are unreachable or cannot reach a final state are trimmed first, so they never enter any subset
+DFA determine(const NFA & nfa, const ConversionOptions & options = {}) {
+    return fromDense(determine(trim(toDense(nfa), options), options));
+}
+
+//union of two NFAs over the same alphabet. States of b are offset by the number of states of a
+//and a new initial state is added which has the transitions of both initial states
+DenseNFA unifyNFA(DenseNFA && a, const DenseNFA & b, const ConversionOptions & options = {}) {
+    STATS_TIMER(options, m_UnifySeconds);
+    size_t columns = a.columns();
+    State offset = a.m_StateCount;
+    auto shiftB = [offset](State state) {
+        return state + offset;
+    };
+
+    //the tables of a are moved into the result, so the row of its initial state is copied first
+    std::vector<uint32_t> initialOffsets(a.m_Offsets.begin() + a.m_InitialState * columns,
+                                         a.m_Offsets.begin() + (a.m_InitialState + 1) * columns + 1);
+    std::vector<State> initialTargets(a.m_Targets.begin() + initialOffsets.front(), a.m_Targets.begin() + initialOffsets.back());
+    bool initialFinal = a.m_Final[a.m_InitialState];
+
+    //states of a keep their IDs, states of b are shifted behind them
+    DenseNFA result;
+    result.m_Alphabet = std::move(a.m_Alphabet);
+    result.m_Offsets = std::move(a.m_Offsets);
+    result.m_Targets = std::move(a.m_Targets);
+    result.m_Final = std::move(a.m_Final);
+    result.m_StateCount = offset;
+    a = DenseNFA();
+    result.reserve(offset + b.m_StateCount + 1, result.m_Targets.size() + b.m_Targets.size() + initialTargets.size()
+                   + b.m_Offsets[(b.m_InitialState + 1) * columns] - b.m_Offsets[b.m_InitialState * columns]);
+
+    for (State state = 0; state < b.m_StateCount; state++) {
+        result.addState(b.m_Final[state]);
+        for (size_t column = 0; column < columns; column++) {
+            result.addTargets(column, b.begin(state, column), b.end(state, column), shiftB);
+        }
+    }
+
+    //the new initial state has the transitions of both initial states
+    result.m_InitialState = result.addState(initialFinal || b.m_Final[b.m_InitialState]);
+    for (size_t column = 0; column < columns; column++) {
+        result.addTargets(column, initialTargets.begin() + (initialOffsets[column] - initialOffsets.front()),
+                          initialTargets.begin() + (initialOffsets[column + 1] - initialOffsets.front()));
+        result.addTargets(column, b.begin(b.m_InitialState, column), b.end(b.m_InitialState, column), shiftB);
+    }
+
+    STATS_PEAK(options, result.bytes());
+    return result;
+}
+
+DenseNFA unifyNFA(const DenseNFA & a, const DenseNFA & b, const ConversionOptions & options = {}) {
+    return unifyNFA(DenseNFA(a), b, options);
+}
+
+NFA unifyNFA(const NFA & a, const NFA & b, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return fromDense(unifyNFA(toDense(a, alphabet), toDense(b, alphabet), options));
+}
+
+DenseDFA unify(const DenseNFA & a, const DenseNFA & b, const ConversionOptions & options = {}) {
+    return minimize(determine(trim(unifyNFA(a, b, options), options), options), options);
+}
+
+//consumes both NFAs, the tables of a become part of their union, and every intermediate automaton
+//is released as soon as the next one is built
+DenseDFA unify(DenseNFA && a, DenseNFA && b, const ConversionOptions & options = {}) {
+    DenseNFA unified = unifyNFA(std::move(a), b, options);
+    b = DenseNFA();
+    unified = trim(std::move(unified), options);
+    DenseDFA determined = determine(unified, options);
+    unified = DenseNFA();
+    return minimize(std::move(determined), options);
+}
+
+DFA unify(const NFA& a, const NFA& b, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return fromDense(unify(toDense(a, alphabet), toDense(b, alphabet), options));
+}
+
+//consumes both NFAs, each is released as soon as it is converted to the dense form
+DFA unify(NFA && a, NFA && b, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    DenseNFA denseA = toDense(a, alphabet);
+    a = NFA();
+    DenseNFA denseB = toDense(b, alphabet);
+    b = NFA();
+    return fromDense(unify(std::move(denseA), std::move(denseB), options));
+}
+
+//pairs of states are packed into one 64-bit key
+uint64_t pairKey(State x, State y) {
+    return (uint64_t(x) << 32) | y;
+}
+
+State pairFirst(uint64_t key) {
+    return key >> 32;
+}
+
+State pairSecond(uint64_t key) {
+    return key & 0xFFFFFFFF;
+}
+
+//product automaton of two DFAs over the same alphabet, a pair is final iff the operation combines the finality
+//of its states to true. State 0 is the sink state, which every pair with a missing transition leads to,
+//so an operand needs to be complete unless a missing transition of it makes every word rejected. The initial pair is state 1
+DenseDFA parallelRunSequential(const DenseDFA & a, const DenseDFA & b, BooleanOperation operation, const ConversionOptions & options) {
+    DenseDFA result;
+    result.m_Alphabet = a.m_Alphabet;
+    size_t columns = a.columns();
+
+    //the nodes of the pair map are released at once with the arena
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::unordered_map<uint64_t, State> pairID(&arena);
+    std::vector<uint64_t> pairs;
+
+    auto intern = [&](State x, State y) {
+        uint64_t key = pairKey(x, y);
+        auto found = pairID.find(key);
+        if (found != pairID.end()) {
+            return found->second;
+        }
+
+        State id = result.addState(combineFinality(operation, a.m_Final[x], b.m_Final[y]));
+        pairID.emplace(key, id);
+        pairs.push_back(key);
+        return id;
+    };
+
+    //sink state will always transition to itself.
+    result.addState(false);
+    pairs.push_back(0);
+    for (size_t column = 0; column < columns; column++) {
+        result.next(0, column) = 0;
+    }
+
+    result.m_InitialState = intern(a.m_InitialState, b.m_InitialState);
+
+    BudgetGuard guard(options.m_Budget);
+    for (State current = 1; current < pairs.size(); current++) {
+        guard.check(pairs.size(), result.bytes() + pairs.capacity() * 3 * sizeof(uint64_t));
+        State x = pairFirst(pairs[current]);
+        State y = pairSecond(pairs[current]);
+
+        for (size_t column = 0; column < columns; column++) {
+            State nextA = a.next(x, column);
+            State nextB = b.next(y, column);
+
+            if (nextA != NO_STATE && nextB != NO_STATE) {
+                State target = intern(nextA, nextB);
+                result.next(current, column) = target;
+            }
+            else {
+                result.next(current, column) = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+//map from pair keys to product states shared by several threads. Keys are distributed over independently locked
+//shards, every entry remembers the first position (in breadth-first order) where its key was found
+class ConcurrentPairTable {
+public:
+    static constexpr size_t SHARDS = 64;
+
+    struct Entry {
+        uint64_t m_Key;
+        uint64_t m_First;
+        State m_ID;
+    };
+
+    //identifies an entry, entries never move between the phases of one level
+    struct Handle {
+        uint32_t m_Shard;
+        uint32_t m_Index;
+    };
+
+    ConcurrentPairTable() {
+        for (auto & shard : m_Shards) {
+            shard = std::make_unique<Shard>();
+        }
+    }
+
+    //finds or adds the key, entries added since levelBegin remember the smallest position they were found at
+    Handle find(uint64_t key, uint64_t position, uint64_t levelBegin) {
+        uint64_t hash = hashWords(&key, 1);
+        uint32_t shardIndex = (hash >> 58) % SHARDS;
+        Shard & shard = *m_Shards[shardIndex];
+        std::lock_guard<std::mutex> lock(shard.m_Mutex);
+
+        size_t mask = shard.m_Slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint32_t index = shard.m_Slots[slot];
+            if (index == EMPTY) {
+                index = shard.m_Entries.size();
+                shard.m_Slots[slot] = index;
+                shard.m_Entries.push_back({key, position, NO_STATE});
+                if (shard.m_Entries.size() * 2 > shard.m_Slots.size()) {
+                    shard.grow();
+                }
+                return {shardIndex, index};
+            }
+
+            Entry & entry = shard.m_Entries[index];
+            if (entry.m_Key == key) {
+                if (entry.m_First >= levelBegin && position < entry.m_First) {
+                    entry.m_First = position;
+                }
+                return {shardIndex, index};
+            }
+        }
+    }
+
+    //must not be called concurrently with find()
+    Entry & entry(Handle handle) {
+        return m_Shards[handle.m_Shard]->m_Entries[handle.m_Index];
+    }
+
+private:
+    static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+    struct Shard {
+        std::mutex m_Mutex;
+        std::vector<uint32_t> m_Slots = std::vector<uint32_t>(16, EMPTY);
+        std::vector<Entry> m_Entries;
+
+        void grow() {
+            m_Slots.assign(m_Slots.size() * 2, EMPTY);
+            size_t mask = m_Slots.size() - 1;
+            for (uint32_t index = 0; index < m_Entries.size(); index++) {
+                uint64_t key = m_Entries[index].m_Key;
+                size_t slot = hashWords(&key, 1) & mask;
+                while (m_Slots[slot] != EMPTY) {
+                    slot = (slot + 1) & mask;
+                }
+                m_Slots[slot] = index;
+            }
+        }
+    };
+
+    std::array<std::unique_ptr<Shard>, SHARDS> m_Shards;
+};
+
+//level-synchronous breadth-first product construction on several threads. Every level runs in three phases:
+//successor pairs of the frontier are looked up in a sharded table, new pairs are numbered in the order
+//of the position they were first found at (a prefix sum over chunks), and the transitions are written into
+//the output table. This gives exactly the numbering of parallelRunSequential
+DenseDFA parallelRunParallel(const DenseDFA & a, const DenseDFA & b, BooleanOperation operation, const ConversionOptions & options) {
+    const size_t CHUNK = 256;
+    const ConcurrentPairTable::Handle SINK = {std::numeric_limits<uint32_t>::max(), 0};
+
+    DenseDFA result;
+    result.m_Alphabet = a.m_Alphabet;
+    size_t columns = a.columns();
+    ConcurrentPairTable table;
+
+    //sink state will always transition to itself.
+    result.addState(false);
+    for (size_t column = 0; column < columns; column++) {
+        result.next(0, column) = 0;
+    }
+
+    uint64_t initialKey = pairKey(a.m_InitialState, b.m_InitialState);
+    table.entry(table.find(initialKey, 0, 0)).m_ID = 1;
+    result.m_InitialState = result.addState(combineFinality(operation, a.m_Final[a.m_InitialState], b.m_Final[b.m_InitialState]));
+
+    std::vector<uint64_t> frontier = {initialKey};
+    std::vector<ConcurrentPairTable::Handle> handles;
+    std::vector<size_t> created;
+    //positions are numbered across all levels, so positions of different levels never compare equal
+    uint64_t levelBegin = 1;
+
+    while (!frontier.empty()) {
+        //a fresh guard checks the clock as well, levels are few but long
+        BudgetGuard(options.m_Budget).check(result.m_StateCount, result.bytes() + handles.capacity() * sizeof(ConcurrentPairTable::Handle));
+        State frontierBegin = result.m_StateCount - frontier.size();
+        size_t chunks = (frontier.size() + CHUNK - 1) / CHUNK;
+        handles.resize(frontier.size() * columns);
+        created.assign(chunks + 1, 0);
+
+        auto forEachPosition = [&](size_t chunk, auto body) {
+            for (size_t i = chunk * CHUNK; i < std::min(frontier.size(), (chunk + 1) * CHUNK); i++) {
+                for (size_t column = 0; column < columns; column++) {
+                    body(i, column, i * columns + column);
+                }
+            }
+        };
+
+        //look up the successors of every frontier pair
+        parallelFor(chunks, options.threads(), [&](size_t chunk) {
+            BudgetGuard(options.m_Budget).check(result.m_StateCount, result.bytes());
+            forEachPosition(chunk, [&](size_t i, size_t column, size_t position) {
+                State nextA = a.next(pairFirst(frontier[i]), column);
+                State nextB = b.next(pairSecond(frontier[i]), column);
+                handles[position] = nextA != NO_STATE && nextB != NO_STATE
+                        ? table.find(pairKey(nextA, nextB), levelBegin + position, levelBegin)
+                        : SINK;
+            });
+        });
+
+        //new pairs are owned by the position they were first found at
+        auto owns = [&](size_t position) {
+            if (handles[position].m_Shard == SINK.m_Shard) {
+                return false;
+            }
+            return table.entry(handles[position]).m_First == levelBegin + position;
+        };
+
+        parallelFor(chunks, options.threads(), [&](size_t chunk) {
+            forEachPosition(chunk, [&](size_t, size_t, size_t position) {
+                created[chunk + 1] += owns(position);
+            });
+        });
+        std::partial_sum(created.begin(), created.end(), created.begin());
+
+        State stateBegin = result.m_StateCount;
+        result.m_StateCount += created.back();
+        result.m_Table.resize(result.m_StateCount * columns, NO_STATE);
+        result.m_Final.resize(result.m_StateCount, false);
+        std::vector<uint64_t> nextFrontier(created.back());
+
+        parallelFor(chunks, options.threads(), [&](size_t chunk) {
+            State id = stateBegin + created[chunk];
+            forEachPosition(chunk, [&](size_t, size_t, size_t position) {
+                if (owns(position)) {
+                    auto & entry = table.entry(handles[position]);
+                    entry.m_ID = id;
+                    result.m_Final[id] = combineFinality(operation, a.m_Final[pairFirst(entry.m_Key)], b.m_Final[pairSecond(entry.m_Key)]);
+                    nextFrontier[id - stateBegin] = entry.m_Key;
+                    ++id;
+                }
+            });
+        });
+
+        //every new pair has its ID now, write the transitions of the frontier
+        parallelFor(chunks, options.threads(), [&](size_t chunk) {
+            forEachPosition(chunk, [&](size_t i, size_t column, size_t position) {
+                ConcurrentPairTable::Handle handle = handles[position];
+                result.next(frontierBegin + i, column) = handle.m_Shard == SINK.m_Shard ? 0 : table.entry(handle).m_ID;
+            });
+        });
+
+        levelBegin += frontier.size() * columns;
+        frontier.swap(nextFrontier);
+    }
+
+    return result;
+}
+
+//single product pass for any boolean operation. An operand is completed only if the operation can accept a pair
+//where its state is missing, e.g. both operands of a union, only the second one of a difference and none of an intersection
+DenseDFA product(const DenseDFA & a, const DenseDFA & b, BooleanOperation operation, const ConversionOptions & options = {}) {
+    STATS_TIMER(options, m_ProductSeconds);
+    bool completeA = combineFinality(operation, false, false) || combineFinality(operation, false, true);
+    bool completeB = combineFinality(operation, false, false) || combineFinality(operation, true, false);
+    DenseDFA completedA = completeA ? complete(a) : DenseDFA();
+    DenseDFA completedB = completeB ? complete(b) : DenseDFA();
+    const DenseDFA & left = completeA ? completedA : a;
+    const DenseDFA & right = completeB ? completedB : b;
+
+    DenseDFA result = options.threads() > 1
+            ? parallelRunParallel(left, right, operation, options)
+            : parallelRunSequential(left, right, operation, options);
+
+    STATS_ADD(options, m_PairsExplored, result.m_StateCount);
+    STATS_PEAK(options, result.bytes() + result.m_StateCount * 2 * sizeof(uint64_t));
+    return result;
+}
+
+DenseDFA parallelRun(const DenseDFA & a, const DenseDFA & b, const ConversionOptions & options = {}) {
+    return product(a, b, BooleanOperation::Intersection, options);
+}
+
+DFA parallelRun(const DFA & a, const DFA & b, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return fromDense(parallelRun(toDense(a, alphabet), toDense(b, alphabet), options));
+}
+
+//minimal DFA of the operation applied to the languages of two DFAs
+DFA product(const DFA & a, const DFA & b, BooleanOperation operation, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return fromDense(minimize(product(toDense(a, alphabet), toDense(b, alphabet), operation, options), options));
+}
+
+//complete DFA accepting exactly the words over its alphabet which the given DFA rejects
+DenseDFA complement(const DenseDFA & dfa) {
+    DenseDFA result = complete(dfa);
+    for (auto & final : result.m_Final) {
+        final = !final;
+    }
+    return result;
+}
+
+//minimal DFA of the complement of the language of the DFA, relative to its alphabet
+DFA complement(const DFA & dfa, const ConversionOptions & options = {}) {
+    return fromDense(minimize(complement(toDense(dfa)), options));
+}
+
+//product of the subset constructions of two NFAs over the same alphabet, only subset pairs reachable from the pair
+//of initial subsets are created. Like in parallelRun, state 0 is the sink state and the initial pair is state 1,
+//every pair containing the empty subset is the sink state
+DenseDFA intersectOnTheFly(const DenseNFA & a, const DenseNFA & b, const ConversionOptions & options = {}) {
+    STATS_TIMER(options, m_ProductSeconds);
+    DenseDFA result;
+    result.m_Alphabet = a.m_Alphabet;
+    size_t columns = a.columns();
+
+    LazyDeterminization subsetsA(a);
+    LazyDeterminization subsetsB(b);
+    //the nodes of the pair map are released at once with the arena
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::unordered_map<uint64_t, State> pairID(&arena);
+    std::vector<uint64_t> pairs;
+
+    auto intern = [&](State x, State y) {
+        if (subsetsA.isEmpty(x) || subsetsB.isEmpty(y)) {
+            return State(0);
+        }
+
+        uint64_t key = pairKey(x, y);
+        auto found = pairID.find(key);
+        if (found != pairID.end()) {
+            return found->second;
+        }
+
+        State id = result.addState(subsetsA.isFinal(x) && subsetsB.isFinal(y));
+        pairID.emplace(key, id);
+        pairs.push_back(key);
+        return id;
+    };
+
+    result.addState(false);
+    pairs.push_back(0);
+    for (size_t column = 0; column < columns; column++) {
+        result.next(0, column) = 0;
+    }
+
+    //the initial pair is created even if one of the subsets is empty, so it is always state 1
+    result.addState(subsetsA.isFinal(0) && subsetsB.isFinal(0));
+    pairID.emplace(pairKey(0, 0), 1);
+    pairs.push_back(pairKey(0, 0));
+    result.m_InitialState = 1;
+
+    BudgetGuard guard(options.m_Budget);
+    for (State current = 1; current < pairs.size(); current++) {
+        guard.check(pairs.size(), subsetsA.bytes() + subsetsB.bytes() + result.bytes() + pairs.capacity() * 3 * sizeof(uint64_t));
+        State x = pairFirst(pairs[current]);
+        State y = pairSecond(pairs[current]);
+
+        for (size_t column = 0; column < columns; column++) {
+            State target = intern(subsetsA.next(x, column), subsetsB.next(y, column));
+            result.next(current, column) = target;
+        }
+    }
+
+    STATS_ADD(options, m_SubsetsCreated, subsetsA.size() + subsetsB.size());
+    STATS_ADD(options, m_PairsExplored, result.m_StateCount);
+    STATS_PEAK(options, subsetsA.bytes() + subsetsB.bytes() + result.bytes() + pairs.capacity() * 3 * sizeof(uint64_t));
+    return result;
+}
+
+//both operands are trimmed first, so their dead states never enter any subset
+DenseDFA intersect(DenseNFA a, DenseNFA b, const ConversionOptions & options = {}) {
+    a = trim(std::move(a), options);
+    b = trim(std::move(b), options);
+    if (options.m_Intersection == IntersectionMode::OnTheFly && options.threads() == 1) {
+        return minimize(intersectOnTheFly(a, b, options), options);
+    }
+
+    DenseDFA determinedA = determine(a, options);
+    DenseDFA determinedB = determine(b, options);
+    return minimize(parallelRun(determinedA, determinedB, options), options);
+}
+
+DFA intersect(const NFA& a, const NFA& b, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return fromDense(intersect(toDense(a, alphabet), toDense(b, alphabet), options));
+}
+
+//consumes both NFAs, each is released as soon as it is converted to the dense form
+DFA intersect(NFA && a, NFA && b, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    DenseNFA denseA = toDense(a, alphabet);
+    a = NFA();
+    DenseNFA denseB = toDense(b, alphabet);
+    b = NFA();
+    return fromDense(intersect(std::move(denseA), std::move(denseB), options));
+}
+
+//minimal DFA of the operation applied to the languages of two NFAs, both are determinized once and combined in one product pass
+DenseDFA combine(const DenseNFA & a, const DenseNFA & b, BooleanOperation operation, const ConversionOptions & options = {}) {
+    DenseDFA determinedA = determine(trim(a, options), options);
+    DenseDFA determinedB = determine(trim(b, options), options);
+    return minimize(product(determinedA, determinedB, operation, options), options);
+}
+
+DFA combine(const NFA & a, const NFA & b, BooleanOperation operation, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return fromDense(combine(toDense(a, alphabet), toDense(b, alphabet), operation, options));
+}
+
+DFA difference(const NFA & a, const NFA & b, const ConversionOptions & options = {}) {
+    return combine(a, b, BooleanOperation::Difference, options);
+}
+
+DFA symmetricDifference(const NFA & a, const NFA & b, const ConversionOptions & options = {}) {
+    return combine(a, b, BooleanOperation::SymmetricDifference, options);
+}
+
+//minimal DFA of the complement of the language of the NFA, relative to its alphabet
+DFA complement(const NFA & nfa, const ConversionOptions & options = {}) {
+    DenseDFA determined = determine(trim(toDense(nfa), options), options);
+    return fromDense(minimize(complement(determined), options));
+}
+
+//the language of a minimized DFA is empty iff it has no final state
+bool isEmptyLanguage(const DenseDFA & dfa) {
+    return std::none_of(dfa.m_Final.begin(), dfa.m_Final.end(), [](uint8_t final) { return final; });
+}
+
+//n-ary reduction behind unifyAll and intersectAll. Every NFA is determinized and minimized, then the DFAs are
+//combined pairwise in a balanced tree, so no operand grows with the number of NFAs folded into it.
+//the pairs of one level run in parallel (each of them on one thread), only a level with a single pair
+//uses all the threads. Intersections pair the smallest operands first and stop once a result is empty
+template <typename Combine>
+DenseDFA reduceAll(const std::vector<NFA> & nfas, bool intersection, const ConversionOptions & options, Combine combine) {
+    DenseAlphabet alphabet = compressedAlphabet(nfas);
+    std::vector<DenseDFA> level(nfas.size());
+    std::atomic<bool> empty{false};
+    std::mutex statsMutex;
+
+    //runs the tasks of one level, statistics of the tasks are collected separately and summed up afterwards
+    auto runLevel = [&](size_t tasks, auto task) {
+        ConversionOptions inner = options;
+        if (tasks > 1) {
+            inner.m_Threads = 1;
+        }
+        parallelFor(tasks, options.threads(), [&](size_t i) {
+            if (intersection && empty.load()) {
+                return;
+            }
+            ConversionStats stats;
+            ConversionOptions taskOptions = inner;
+            taskOptions.m_Stats = options.m_Stats ? &stats : nullptr;
+            DenseDFA result = task(i, taskOptions);
+            if (isEmptyLanguage(result)) {
+                empty = true;
+            }
+            if (options.m_Stats) {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                options.m_Stats->add(stats);
+            }
+            level[i] = std::move(result);
+        });
+    };
+
+    auto emptyResult = [&] {
+        DenseDFA result;
+        result.m_Alphabet = alphabet;
+        result.addState(false);
+        return result;
+    };
+
+    runLevel(nfas.size(), [&](size_t i, const ConversionOptions & taskOptions) {
+        return minimize(determine(trim(toDense(nfas[i], alphabet), taskOptions), taskOptions), taskOptions);
+    });
+
+    while (level.size() > 1) {
+        if (intersection && empty) {
+            return emptyResult();
+        }
+        if (intersection) {
+            std::stable_sort(level.begin(), level.end(), [](const DenseDFA & x, const DenseDFA & y) {
+                return x.m_StateCount < y.m_StateCount;
+            });
+        }
+
+        std::vector<DenseDFA> operands = std::move(level);
+        level.assign((operands.size() + 1) / 2, DenseDFA());
+        runLevel(operands.size() / 2, [&](size_t i, const ConversionOptions & taskOptions) {
+            return combine(operands[2 * i], operands[2 * i + 1], taskOptions);
+        });
+        if (operands.size() % 2 != 0) {
+            level.back() = std::move(operands.back());
+        }
+    }
+
+    if (level.empty()) {
+        //the empty union is the empty language, the empty intersection accepts everything
+        DenseDFA result = emptyResult();
+        result.m_Final[0] = intersection;
+        return result;
+    }
+    if (intersection && empty) {
+        return emptyResult();
+    }
+    return std::move(level[0]);
+}
+
+//minimal DFA of the union of all the NFAs
+DFA unifyAll(const std::vector<NFA> & nfas, const ConversionOptions & options = {}) {
+    return fromDense(reduceAll(nfas, false, options, [](const DenseDFA & a, const DenseDFA & b, const ConversionOptions & inner) {
+        return minimize(product(a, b, BooleanOperation::Union, inner), inner);
+    }));
+}
+
+//minimal DFA of the intersection of all the NFAs
+DFA intersectAll(const std::vector<NFA> & nfas, const ConversionOptions & options = {}) {
+    return fromDense(reduceAll(nfas, true, options, [](const DenseDFA & a, const DenseDFA & b, const ConversionOptions & inner) {
+        return minimize(parallelRun(a, b, inner), inner);
+    }));
+}
+
+
+//DFA recognizing several patterns at once. Every state belongs to an accept class, m_TagSets[class] are the
+//sorted IDs of the patterns accepting the words leading to the state. Class 0 is the empty set of the non-final states
+struct MultiPatternDFA {
+    DenseDFA m_DFA;
+    std::vector<State> m_Accept;
+    std::vector<std::vector<uint32_t>> m_TagSets;
+
+    //IDs of all the patterns matching the whole input
+    const std::vector<uint32_t> & matches(std::string_view input) const {
+        State state = m_DFA.m_InitialState;
+        for (unsigned char byte : input) {
+            uint16_t column = m_DFA.m_Alphabet.m_Column[byte];
+            if (column == NO_COLUMN || (state = m_DFA.next(state, column)) == NO_STATE) {
+                return m_TagSets[0];
+            }
+        }
+        return m_TagSets[m_Accept[state]];
+    }
+};
+
+//subset construction starting from the set of the initial states of all patterns. Each NFA state belongs to
+//the pattern patternOf[state], the tag set of a subset are the patterns of its final states.
+//tag sets are interned into accept classes, the empty set is class 0
+MultiPatternDFA determineTagged(const DenseNFA & nfa, const std::vector<State> & initialStates,
+                                const std::vector<uint32_t> & patternOf, const ConversionOptions & options) {
+    STATS_TIMER(options, m_DetermineSeconds);
+    MultiPatternDFA result;
+    SubsetSuccessors successors(nfa);
+    std::map<std::vector<uint32_t>, State> classOf = {{{}, 0}};
+    result.m_TagSets.emplace_back();
+    std::vector<uint32_t> tags;
+
+    SubsetBuffer initial(successors.words());
+    for (auto state : initialStates) {
+        initial.set(state);
+    }
+
+    result.m_DFA = subsetConstruction(nfa, successors, initial, options, [&](const SubsetBuffer & subset) {
+        tags.clear();
+        subset.forEach([&](State state) {
+            if (nfa.m_Final[state]) {
+                tags.push_back(patternOf[state]);
+            }
+        });
+        std::sort(tags.begin(), tags.end());
+        tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+
+        auto interned = classOf.emplace(tags, result.m_TagSets.size());
+        if (interned.second) {
+            result.m_TagSets.push_back(tags);
+        }
+        result.m_Accept.push_back(interned.first->second);
+        return !tags.empty();
+    });
+    return result;
+}
+
+//minimal DFA of all the patterns in which every final state reports the IDs (indices) of the patterns it accepts.
+//the patterns are trimmed and placed side by side in one NFA, instead of adding a new initial state the subset
+//construction starts from all of their initial states. Minimization never merges states with different tag sets
+MultiPatternDFA buildMultiPattern(const std::vector<NFA> & patterns, const ConversionOptions & options = {}) {
+    DenseAlphabet alphabet = compressedAlphabet(patterns);
+    DenseNFA combined;
+    combined.m_Alphabet = alphabet;
+    std::vector<uint32_t> patternOf;
+    std::vector<State> initialStates;
+
+    for (uint32_t pattern = 0; pattern < patterns.size(); pattern++) {
+        DenseNFA dense = trim(toDense(patterns[pattern], alphabet), options);
+        State offset = combined.m_StateCount;
+        auto shift = [offset](State state) {
+            return state + offset;
+        };
+        combined.reserve(offset + dense.m_StateCount, combined.m_Targets.size() + dense.m_Targets.size());
+        for (State state = 0; state < dense.m_StateCount; state++) {
+            combined.addState(dense.m_Final[state]);
+            patternOf.push_back(pattern);
+            for (size_t column = 0; column < dense.columns(); column++) {
+                combined.addTargets(column, dense.begin(state, column), dense.end(state, column), shift);
+            }
+        }
+        initialStates.push_back(offset + dense.m_InitialState);
+    }
+
+    MultiPatternDFA result = determineTagged(combined, initialStates, patternOf, options);
+    result.m_DFA = minimizeClasses(std::move(result.m_DFA), result.m_Accept, options);
+    return result;
+}
+
+//builds the minimal DFA of a finite set of words incrementally (Daciuk et al.). States which cannot change any more
+//are kept in a register holding one state per equivalence class, a new state equivalent to a registered one
+//is replaced by it, so the automaton never grows much beyond its minimal size.
+//in sorted mode, words have to be added in lexicographic order and only the states along the last word are not
+//registered yet. Otherwise words may come in any order, every state stays registered between the words
+//and states shared by several words (confluence states) are cloned before a word changes them
+class IncrementalDFABuilder {
+public:
+    explicit IncrementalDFABuilder(bool sorted = true)
+            : m_Sorted(sorted),
+              m_Register(0, NodeHash{m_Nodes}, NodeEqual{m_Nodes}),
+              m_Path(1, ROOT) {
+        m_Nodes.emplace_back();
+    }
+
+    //the register refers to the nodes of this builder
+    IncrementalDFABuilder(const IncrementalDFABuilder &) = delete;
+    IncrementalDFABuilder & operator=(const IncrementalDFABuilder &) = delete;
+
+    void add(std::string_view word) {
+        if (m_Finished) {
+            throw std::logic_error("IncrementalDFABuilder: words added after finish()");
+        }
+        if (m_Sorted) {
+            addSorted(word);
+        }
+        else {
+            addUnsorted(word);
+        }
+    }
+
+    //number of states currently held, including the states of the last word which are not registered yet
+    size_t states() const {
+        return m_Nodes.size() - m_Free.size();
+    }
+
+    //registers the remaining states and returns the minimal DFA of all the words, with one column per symbol
+    //used and states numbered canonically. No words can be added afterwards
+    DenseDFA finishDense() {
+        if (m_Sorted && !m_Finished) {
+            registerPath(0);
+        }
+        m_Finished = true;
+
+        std::set<Symbol> symbols;
+        for (auto & node : m_Nodes) {
+            for (auto & edge : node.m_Edges) {
+                symbols.insert(edge.first);
+            }
+        }
+
+        DenseDFA result;
+        result.m_Alphabet = makeAlphabet(symbols);
+        result.reserve(states());
+        std::vector<State> rename(m_Nodes.size(), NO_STATE);
+        std::vector<State> order = {ROOT};
+        rename[ROOT] = result.addState(m_Nodes[ROOT].m_Final);
+        result.m_InitialState = 0;
+
+        //breadth-first in order of the symbols, which is the numbering of canonicalize()
+        for (size_t i = 0; i < order.size(); i++) {
+            for (auto & edge : m_Nodes[order[i]].m_Edges) {
+                if (rename[edge.second] == NO_STATE) {
+                    rename[edge.second] = result.addState(m_Nodes[edge.second].m_Final);
+                    order.push_back(edge.second);
+                }
+                result.next(i, result.m_Alphabet.m_Column[edge.first]) = rename[edge.second];
+            }
+        }
+
+        return result;
+    }
+
+    DFA finish() {
+        return fromDense(finishDense());
+    }
+
+private:
+    static constexpr State ROOT = 0;
+
+    //transitions are sorted by symbol
+    struct Node {
+        std::vector<std::pair<Symbol, State>> m_Edges;
+        uint32_t m_InDegree = 0;
+        bool m_Final = false;
+    };
+
+    //registered states are compared by their right language, which for states with registered successors
+    //is given by their finality and their transitions
+    struct NodeHash {
+        const std::vector<Node> & m_Nodes;
+
+        size_t operator()(State state) const {
+            const Node & node = m_Nodes[state];
+            uint64_t hash = node.m_Final;
+            for (auto & edge : node.m_Edges) {
+                hash = (hash ^ (uint64_t(edge.first) << 32 | edge.second)) * 0x9E3779B97F4A7C15ull;
+                hash ^= hash >> 29;
+            }
+            return hash;
+        }
+    };
+
+    struct NodeEqual {
+        const std::vector<Node> & m_Nodes;
+
+        bool operator()(State x, State y) const {
+            return m_Nodes[x].m_Final == m_Nodes[y].m_Final && m_Nodes[x].m_Edges == m_Nodes[y].m_Edges;
+        }
+    };
+
+    State newState() {
+        if (!m_Free.empty()) {
+            State state = m_Free.back();
+            m_Free.pop_back();
+            return state;
+        }
+        m_Nodes.emplace_back();
+        return m_Nodes.size() - 1;
+    }
+
+    //drops a state which is no longer referenced
+    void release(State state) {
+        for (auto & edge : m_Nodes[state].m_Edges) {
+            m_Nodes[edge.second].m_InDegree--;
+        }
+        m_Nodes[state] = Node();
+        m_Free.push_back(state);
+    }
+
+    State & target(State state, Symbol symbol) {
+        auto & edges = m_Nodes[state].m_Edges;
+        auto found = std::lower_bound(edges.begin(), edges.end(), symbol, [](auto & edge, Symbol s) { return edge.first < s; });
+        return found->second;
+    }
+
+    State find(State state, Symbol symbol) const {
+        auto & edges = m_Nodes[state].m_Edges;
+        auto found = std::lower_bound(edges.begin(), edges.end(), symbol, [](auto & edge, Symbol s) { return edge.first < s; });
+        return found != edges.end() && found->first == symbol ? found->second : NO_STATE;
+    }
+
+    //appends the states of word[prefix..] to the end of the path, m_Path.back() has to be the state after the prefix
+    void appendSuffix(std::string_view word, size_t prefix) {
+        for (size_t i = prefix; i < word.size(); i++) {
+            State state = newState();
+            auto & edges = m_Nodes[m_Path.back()].m_Edges;
+            auto position = std::lower_bound(edges.begin(), edges.end(), Symbol(word[i]), [](auto & edge, Symbol s) { return edge.first < s; });
+            edges.insert(position, {Symbol(word[i]), state});
+            m_Nodes[state].m_InDegree = 1;
+            m_Path.push_back(state);
+        }
+        m_Nodes[m_Path.back()].m_Final = true;
+    }
+
+    //the state reached from parent by symbol is replaced by its registered equivalent, or registered itself
+    void replaceOrRegister(State parent, Symbol symbol) {
+        State & child = target(parent, symbol);
+        auto found = m_Register.find(child);
+        if (found == m_Register.end()) {
+            m_Register.insert(child);
+            return;
+        }
+
+        State replaced = child;
+        child = *found;
+        m_Nodes[child].m_InDegree++;
+        release(replaced);
+    }
+
+    //registers the states of the path behind its first `keep` symbols, deepest first
+    void registerPath(size_t keep) {
+        for (size_t i = m_Path.size() - 1; i > keep; i--) {
+            replaceOrRegister(m_Path[i - 1], m_Previous[i - 1]);
+        }
+        m_Path.resize(keep + 1);
+    }
+
+    void addSorted(std::string_view word) {
+        if (word < m_Previous) {
+            throw std::invalid_argument("IncrementalDFABuilder: words are not sorted");
+        }
+        size_t prefix = std::mismatch(word.begin(), word.end(), m_Previous.begin(), m_Previous.end()).first - word.begin();
+        registerPath(prefix);
+        appendSuffix(word, prefix);
+        m_Previous = word;
+    }
+
+    void addUnsorted(std::string_view word) {
+        m_Path.assign(1, ROOT);
+        size_t prefix = 0;
+        for (State next; prefix < word.size() && (next = find(m_Path.back(), word[prefix])) != NO_STATE; prefix++) {
+            m_Path.push_back(next);
+        }
+        if (prefix == word.size() && m_Nodes[m_Path.back()].m_Final) {
+            return;
+        }
+
+        //states of the prefix change, so they leave the register. From the first confluence state on,
+        //the states are still used by other words and the word continues through clones of them
+        size_t confluence = 1;
+        while (confluence < m_Path.size() && m_Nodes[m_Path[confluence]].m_InDegree == 1) {
+            m_Register.erase(m_Path[confluence++]);
+        }
+        for (size_t i = confluence; i < m_Path.size(); i++) {
+            State clone = newState();
+            m_Nodes[clone].m_Edges = m_Nodes[m_Path[i]].m_Edges;
+            m_Nodes[clone].m_Final = m_Nodes[m_Path[i]].m_Final;
+            m_Nodes[clone].m_InDegree = 1;
+            for (auto & edge : m_Nodes[clone].m_Edges) {
+                m_Nodes[edge.second].m_InDegree++;
+            }
+            m_Nodes[m_Path[i]].m_InDegree--;
+            target(m_Path[i - 1], word[i - 1]) = clone;
+            m_Path[i] = clone;
+        }
+
+        appendSuffix(word, prefix);
+        for (size_t i = m_Path.size() - 1; i > 0; i--) {
+            replaceOrRegister(m_Path[i - 1], word[i - 1]);
+        }
+    }
+
+    bool m_Sorted;
+    bool m_Finished = false;
+    std::vector<Node> m_Nodes;
+    std::vector<State> m_Free;
+    std::unordered_set<State, NodeHash, NodeEqual> m_Register;
+    //states along the last word, m_Path[i] is reached by its first i symbols
+    std::vector<State> m_Path;
+    std::string m_Previous;
+};
+
+//128-bit structural hash, two independently seeded 64-bit lanes
+struct Hash128 {
+    uint64_t m_Low = 0;
+    uint64_t m_High = 0;
+
+    bool operator==(const Hash128 & other) const {
+        return m_Low == other.m_Low && m_High == other.m_High;
+    }
+
+    struct Hasher {
+        size_t operator()(const Hash128 & hash) const {
+            return hash.m_Low ^ (hash.m_High * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+};
+
+//accumulates 64-bit values into a Hash128. The result only depends on the values added and their order,
+//so hashes are stable between runs and platforms
+class StructuralHasher {
+public:
+    void add(uint64_t value) {
+        m_Low = mix((m_Low ^ value) * 0xFF51AFD7ED558CCDULL);
+        m_High = mix((m_High + value) * 0xC4CEB9FE1A85EC53ULL + 0x632BE59BD9B4E019ULL);
+        m_Count++;
+    }
+
+    Hash128 digest() const {
+        return {mix(m_Low ^ m_Count), mix(m_High + m_Count * 0x9E3779B97F4A7C15ULL)};
+    }
+
+private:
+    static uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        return value ^ (value >> 33);
+    }
+
+    uint64_t m_Low = 0x243F6A8885A308D3ULL;
+    uint64_t m_High = 0x13198A2E03707344ULL;
+    uint64_t m_Count = 0;
+};
+
+//the DFA with states renumbered 0..n-1 in breadth-first order from the initial state, visiting successors
+//in order of their symbols. Unreachable states follow in their original order. Two DFAs which differ only
+//in the naming of their states have the same canonical form
+DenseDFA canonicalDense(const DFA & dfa) {
+    return canonicalize(toDense(dfa, makeAlphabet(dfa.m_Alphabet)));
+}
+
+DFA canonicalForm(const DFA & dfa) {
+    return fromDense(canonicalDense(dfa));
+}
+
+Hash128 structuralHash(const DenseDFA & canonical) {
+    StructuralHasher hasher;
+    hasher.add(canonical.m_Alphabet.m_Symbols.size());
+    for (auto symbol : canonical.m_Alphabet.m_Symbols) {
+        hasher.add(symbol);
+    }
+    hasher.add(canonical.m_StateCount);
+    for (State state = 0; state < canonical.m_StateCount; state++) {
+        hasher.add(canonical.m_Final[state]);
+        for (size_t column = 0; column < canonical.columns(); column++) {
+            hasher.add(canonical.next(state, column));
+        }
+    }
+    return hasher.digest();
+}
+
+//hash of the canonical form, equal DFAs up to the naming of their states have equal hashes
+Hash128 structuralHash(const DFA & dfa) {
+    return structuralHash(canonicalDense(dfa));
+}
+
+//hash of the part of an NFA reachable from its initial state. States are numbered in breadth-first order,
+//visiting symbols in order and the targets of one transition in order of their IDs, so NFAs which differ
+//by a renaming preserving the order of state IDs (e.g. shifted or sparse IDs) or by unreachable states hash equally
+Hash128 structuralHash(const NFA & nfa) {
+    DenseNFA dense = toDense(nfa, makeAlphabet(nfa.m_Alphabet));
+    StructuralHasher hasher;
+    hasher.add(dense.m_Alphabet.m_Symbols.size());
+    for (auto symbol : dense.m_Alphabet.m_Symbols) {
+        hasher.add(symbol);
+    }
+    if (dense.m_StateCount == 0) {
+        return hasher.digest();
+    }
+
+    std::vector<State> rename(dense.m_StateCount, NO_STATE);
+    std::vector<State> order = {dense.m_InitialState};
+    rename[dense.m_InitialState] = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        hasher.add(dense.m_Final[order[i]]);
+        for (size_t column = 0; column < dense.columns(); column++) {
+            hasher.add(dense.end(order[i], column) - dense.begin(order[i], column));
+            for (auto target = dense.begin(order[i], column); target != dense.end(order[i], column); target++) {
+                if (rename[*target] == NO_STATE) {
+                    rename[*target] = order.size();
+                    order.push_back(*target);
+                }
+                hasher.add(rename[*target]);
+            }
+        }
+    }
+    return hasher.digest();
+}
+
+//thread-safe cache of conversion results, keyed by the structural hashes of the operands and the operation.
+//the least recently used results are evicted once their approximate size exceeds the capacity.
+//results are minimal DFAs, which do not depend on the options, so calls with different options share entries.
+//a result missing from the cache is computed outside of the lock, concurrent misses of one key may compute it twice
+class ConversionCache {
+public:
+    explicit ConversionCache(size_t capacityBytes)
+            : m_Capacity(capacityBytes) {
+    }
+
+    DFA unify(const NFA & a, const NFA & b, const ConversionOptions & options = {}) {
+        return cached(key(BooleanOperation::Union, a, b), [&] { return ::unify(a, b, options); });
+    }
+
+    DFA intersect(const NFA & a, const NFA & b, const ConversionOptions & options = {}) {
+        return cached(key(BooleanOperation::Intersection, a, b), [&] { return ::intersect(a, b, options); });
+    }
+
+    DFA combine(const NFA & a, const NFA & b, BooleanOperation operation, const ConversionOptions & options = {}) {
+        return cached(key(operation, a, b), [&] { return ::combine(a, b, operation, options); });
+    }
+
+    size_t hits() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Hits;
+    }
+
+    size_t misses() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Misses;
+    }
+
+    size_t bytes() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Bytes;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Entries.clear();
+        m_Index.clear();
+        m_Bytes = 0;
+    }
+
+private:
+    struct Entry {
+        Hash128 m_Key;
+        std::shared_ptr<const DFA> m_Result;
+        size_t m_Bytes;
+    };
+
+    //approximate heap size of a DFA, counting one tree node per state, final state and transition
+    static size_t approximateBytes(const DFA & dfa) {
+        return (dfa.m_States.size() + dfa.m_FinalStates.size() + dfa.m_Alphabet.size()) * 40 + dfa.m_Transitions.size() * 48;
+    }
+
+    //symmetric operations hash their operands in a fixed order, so unify(a, b) and unify(b, a) share an entry
+    static Hash128 key(BooleanOperation operation, const NFA & a, const NFA & b) {
+        Hash128 first = structuralHash(a);
+        Hash128 second = structuralHash(b);
+        bool symmetric = operation == BooleanOperation::Union || operation == BooleanOperation::Intersection
+                || operation == BooleanOperation::SymmetricDifference;
+        if (symmetric && std::tie(second.m_High, second.m_Low) < std::tie(first.m_High, first.m_Low)) {
+            std::swap(first, second);
+        }
+
+        StructuralHasher hasher;
+        hasher.add(uint8_t(operation));
+        for (auto value : {first.m_Low, first.m_High, second.m_Low, second.m_High}) {
+            hasher.add(value);
+        }
+        return hasher.digest();
+    }
+
+    std::shared_ptr<const DFA> find(const Hash128 & key) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_Index.find(key);
+        if (found == m_Index.end()) {
+            m_Misses++;
+            return nullptr;
+        }
+        m_Hits++;
+        m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+        return found->second->m_Result;
+    }
+
+    //hits are copied outside of the lock, the shared pointer keeps an evicted result alive meanwhile
+    template <typename Conversion>
+    DFA cached(const Hash128 & key, Conversion conversion) {
+        if (std::shared_ptr<const DFA> hit = find(key)) {
+            return *hit;
+        }
+
+        auto result = std::make_shared<const DFA>(conversion());
+        size_t bytes = approximateBytes(*result);
+        if (bytes > m_Capacity) {
+            return *result;
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Index.find(key) == m_Index.end()) {
+            m_Entries.push_front({key, result, bytes});
+            m_Index.emplace(key, m_Entries.begin());
+            m_Bytes += bytes;
+            while (m_Bytes > m_Capacity) {
+                m_Bytes -= m_Entries.back().m_Bytes;
+                m_Index.erase(m_Entries.back().m_Key);
+                m_Entries.pop_back();
+            }
+        }
+        return *result;
+    }
+
+    size_t m_Capacity;
+    mutable std::mutex m_Mutex;
+    //most recently used first
+    std::list<Entry> m_Entries;
+    std::unordered_map<Hash128, std::list<Entry>::iterator, Hash128::Hasher> m_Index;
+    size_t m_Bytes = 0;
+    size_t m_Hits = 0;
+    size_t m_Misses = 0;
+};
+
+//outcome of a budgeted conversion. If the budget was exceeded, m_Result is empty and m_States and m_Bytes
+//describe the phase which was stopped, m_Stats holds whatever was collected until then
+template <typename T>
+struct BudgetedResult {
+    ConversionStatus m_Status = ConversionStatus::Completed;
+    std::optional<T> m_Result;
+    size_t m_States = 0;
+    size_t m_Bytes = 0;
+    ConversionStats m_Stats;
+};
+
+//runs a conversion under options.m_Budget. Statistics go to options.m_Stats if set, otherwise to the result
+template <typename T, typename Conversion>
+BudgetedResult<T> runBudgeted(const ConversionOptions & options, Conversion conversion) {
+    BudgetedResult<T> result;
+    ConversionOptions budgeted = options;
+    if (!budgeted.m_Stats) {
+        budgeted.m_Stats = &result.m_Stats;
+    }
+
+    try {
+        result.m_Result = conversion(budgeted);
+    }
+    catch (const BudgetExceeded & exceeded) {
+        result.m_Status = exceeded.m_Status;
+        result.m_States = exceeded.m_States;
+        result.m_Bytes = exceeded.m_Bytes;
+    }
+    catch (const std::bad_alloc &) {
+        result.m_Status = ConversionStatus::MemoryLimitExceeded;
+    }
+
+    if (budgeted.m_Stats != &result.m_Stats) {
+        result.m_Stats = *budgeted.m_Stats;
+    }
+    return result;
+}
+
+BudgetedResult<DFA> determineBudgeted(const NFA & nfa, const ConversionOptions & options) {
+    return runBudgeted<DFA>(options, [&](const ConversionOptions & budgeted) {
+        return determine(nfa, budgeted);
+    });
+}
+
+BudgetedResult<DFA> unifyBudgeted(const NFA & a, const NFA & b, const ConversionOptions & options) {
+    return runBudgeted<DFA>(options, [&](const ConversionOptions & budgeted) {
+        return unify(a, b, budgeted);
+    });
+}
+
+BudgetedResult<DFA> intersectBudgeted(const NFA & a, const NFA & b, const ConversionOptions & options) {
+    return runBudgeted<DFA>(options, [&](const ConversionOptions & budgeted) {
+        return intersect(a, b, budgeted);
+    });
+}
+
+//answer of a language query. If the query does not hold, m_Counterexample is a word witnessing it
+struct QueryResult {
+    bool m_Holds;
+    std::vector<Symbol> m_Counterexample;
+};
+
+//node of a breadth-first search over pairs, the word leading to a node is recovered through its parents
+struct SearchNode {
+    uint64_t m_Key;
+    uint32_t m_Parent;
+    uint16_t m_Column;
+};
+
+std::vector<Symbol> traceWord(const std::vector<SearchNode> & nodes, uint32_t node, const DenseAlphabet & alphabet) {
+    std::vector<Symbol> word;
+    for (; node != 0; node = nodes[node].m_Parent) {
+        word.push_back(alphabet.symbol(nodes[node].m_Column));
+    }
+    std::reverse(word.begin(), word.end());
+    return word;
+}
+
+//the intersection is empty iff no pair of final states is reachable in the product of the two NFAs,
+//so no subsets are needed at all. The search stops at the first (and shortest) common word
+QueryResult isEmptyIntersection(const DenseNFA & a, const DenseNFA & b) {
+    std::vector<SearchNode> nodes = {{pairKey(a.m_InitialState, b.m_InitialState), 0, 0}};
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::unordered_map<uint64_t, uint32_t> visited(&arena);
+    visited.emplace(nodes[0].m_Key, 0);
+
+    if (a.m_Final[a.m_InitialState] && b.m_Final[b.m_InitialState]) {
+        return {false, {}};
+    }
+
+    for (uint32_t current = 0; current < nodes.size(); current++) {
+        State x = pairFirst(nodes[current].m_Key);
+        State y = pairSecond(nodes[current].m_Key);
+
+        for (size_t column = 0; column < a.columns(); column++) {
+            for (auto nextA = a.begin(x, column); nextA != a.end(x, column); nextA++) {
+                for (auto nextB = b.begin(y, column); nextB != b.end(y, column); nextB++) {
+                    uint64_t key = pairKey(*nextA, *nextB);
+                    if (!visited.emplace(key, nodes.size()).second) {
+                        continue;
+                    }
+
+                    nodes.push_back({key, current, uint16_t(column)});
+                    if (a.m_Final[*nextA] && b.m_Final[*nextB]) {
+                        return {false, traceWord(nodes, nodes.size() - 1, a.m_Alphabet)};
+                    }
+                }
+            }
+        }
+    }
+
+    return {true, {}};
+}
+
+QueryResult isEmptyIntersection(const NFA & a, const NFA & b) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return isEmptyIntersection(toDense(a, alphabet), toDense(b, alphabet));
+}
+
+//language inclusion by the antichain algorithm: searches pairs (state of a, subset of b) for a final state of a
+//paired with a non-final subset. A pair (p, S) is skipped if some (p, S') with S' a subset of S was already
+//visited, since every word rejected from (p, S) is rejected from (p, S') as well. The counterexample is shortest
+QueryResult isSubset(const DenseNFA & a, const DenseNFA & b) {
+    LazyDeterminization subsetsB(b);
+    //minimal subsets of b visited together with every state of a, allocated from one arena
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::vector<std::pmr::vector<State>> antichain(a.m_StateCount, &arena);
+
+    //adds the subset to the antichain of the state unless it is covered by a smaller one
+    auto visit = [&](State state, State subset) {
+        auto & minimal = antichain[state];
+        for (auto other : minimal) {
+            if (subsetsB.isSubsetOf(other, subset)) {
+                return false;
+            }
+        }
+        minimal.erase(std::remove_if(minimal.begin(), minimal.end(), [&](State other) {
+            return subsetsB.isSubsetOf(subset, other);
+        }), minimal.end());
+        minimal.push_back(subset);
         return true;
+    };
+
+    std::vector<SearchNode> nodes = {{pairKey(a.m_InitialState, 0), 0, 0}};
+    visit(a.m_InitialState, 0);
+    if (a.m_Final[a.m_InitialState] && !subsetsB.isFinal(0)) {
+        return {false, {}};
+    }
+
+    for (uint32_t current = 0; current < nodes.size(); current++) {
+        State state = pairFirst(nodes[current].m_Key);
+        State subset = pairSecond(nodes[current].m_Key);
+
+        for (size_t column = 0; column < a.columns(); column++) {
+            if (a.begin(state, column) == a.end(state, column)) {
+                continue;
+            }
+
+            State nextSubset = subsetsB.next(subset, column);
+            for (auto next = a.begin(state, column); next != a.end(state, column); next++) {
+                if (!visit(*next, nextSubset)) {
+                    continue;
+                }
+
+                nodes.push_back({pairKey(*next, nextSubset), current, uint16_t(column)});
+                if (a.m_Final[*next] && !subsetsB.isFinal(nextSubset)) {
+                    return {false, traceWord(nodes, nodes.size() - 1, a.m_Alphabet)};
+                }
+            }
+        }
+    }
+
+    return {true, {}};
+}
+
+//L(a) is a subset of L(b), otherwise the counterexample is a word of a which b rejects
+QueryResult isSubset(const NFA & a, const NFA & b) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return isSubset(toDense(a, alphabet), toDense(b, alphabet));
+}
+
+//language equivalence by Hopcroft and Karp: both NFAs are determinized lazily and pairs of subsets are merged
+//in a union-find structure, a pair whose subsets are already known to be equivalent is not explored again.
+//the search stops at the first pair which disagrees on acceptance
+QueryResult areEquivalent(const DenseNFA & a, const DenseNFA & b) {
+    LazyDeterminization subsetsA(a);
+    LazyDeterminization subsetsB(b);
+    //subset x of a is element 2x, subset y of b is element 2y + 1
+    std::vector<uint32_t> parent;
+
+    auto find = [&](uint32_t element) {
+        if (element >= parent.size()) {
+            size_t size = parent.size();
+            parent.resize(std::max<size_t>(element + 1, size * 2));
+            std::iota(parent.begin() + size, parent.end(), size);
+        }
+        while (parent[element] != element) {
+            parent[element] = parent[parent[element]];
+            element = parent[element];
+        }
+        return element;
+    };
+
+    std::vector<SearchNode> nodes = {{pairKey(0, 0), 0, 0}};
+    if (subsetsA.isFinal(0) != subsetsB.isFinal(0)) {
+        return {false, {}};
+    }
+    parent = {1, 1};
+
+    for (uint32_t current = 0; current < nodes.size(); current++) {
+        State x = pairFirst(nodes[current].m_Key);
+        State y = pairSecond(nodes[current].m_Key);
+
+        for (size_t column = 0; column < a.columns(); column++) {
+            State nextA = subsetsA.next(x, column);
+            State nextB = subsetsB.next(y, column);
+            uint32_t rootA = find(2 * nextA);
+            uint32_t rootB = find(2 * nextB + 1);
+            if (rootA == rootB) {
+                continue;
+            }
+
+            parent[rootA] = rootB;
+            nodes.push_back({pairKey(nextA, nextB), current, uint16_t(column)});
+            if (subsetsA.isFinal(nextA) != subsetsB.isFinal(nextB)) {
+                return {false, traceWord(nodes, nodes.size() - 1, a.m_Alphabet)};
+            }
+        }
+    }
+
+    return {true, {}};
+}
+
+//L(a) equals L(b), otherwise the counterexample is a word accepted by exactly one of them
+QueryResult areEquivalent(const NFA & a, const NFA & b) {
+    DenseAlphabet alphabet = compressedAlphabet(a, b);
+    return areEquivalent(toDense(a, alphabet), toDense(b, alphabet));
+}
+
+//header of a compiled DFA image. The image is the in-memory and the on-disk form of a compiled DFA:
+//the header, the byte -> column map (256 words) and the transition table, all 32 bit words in the byte order
+//of the machine which compiled it. m_ByteOrder records that order, images of the other order are rejected.
+//the header is 64 bytes, so the table starts at a cache line boundary of an aligned image
+struct MatcherHeader {
+    static constexpr uint32_t MAGIC = 0x41464452;
+    static constexpr uint32_t VERSION = 2;
+    static constexpr size_t WORDS = 16;
+    //reads as SWAPPED_ORDER_MARK on a machine of the other byte order
+    static constexpr uint32_t ORDER_MARK = 0x01020304;
+    static constexpr uint32_t SWAPPED_ORDER_MARK = 0x04030201;
+
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    uint32_t m_ByteOrder;
+    uint32_t m_Stride;
+    uint32_t m_InitialState;
+    uint32_t m_FirstFinal;
+    uint32_t m_TableSize;
+    uint32_t m_Reserved[WORDS - 7];
+};
+
+static_assert(sizeof(MatcherHeader) == MatcherHeader::WORDS * sizeof(uint32_t));
+
+//non-owning view of a compiled DFA image, which may be owned by a CompiledDFA or mapped from a file.
+//transitions are one flat table indexed by state + column of the byte, a state ID is the offset of its row,
+//so one step is two loads with no multiplication. The rows only have one column per symbol class plus one
+//for the bytes outside of the alphabet, which keeps the table small enough for the cache.
+//row 0 is the dead state, it replaces all missing transitions and all states which cannot reach a final state,
+//so the sink of a complete DFA is recognized as dead as well. Final states get the highest IDs,
+//which folds the accept flag into the ID: a state is final iff it is at least m_FirstFinal
+class MatcherView {
+public:
+    static constexpr uint32_t DEAD = 0;
+
+    //the image must outlive the view
+    explicit MatcherView(const uint32_t * image) {
+        bind(image);
+    }
+
+    size_t bytes() const {
+        return (MatcherHeader::WORDS + 256 + m_TableSize) * sizeof(uint32_t);
+    }
+
+    //every transition and every class leads into the table, needed for images from untrusted sources
+    bool verify() const {
+        for (size_t i = 0; i < m_TableSize; i++) {
+            if (m_Table[i] >= m_TableSize || m_Table[i] % m_Stride != 0) {
+                return false;
+            }
+        }
+        return std::all_of(m_Class, m_Class + 256, [&](uint32_t column) { return column < m_Stride; });
+    }
+
+    uint32_t initialState() const {
+        return m_InitialState;
+    }
+
+    bool isFinal(uint32_t state) const {
+        return state >= m_FirstFinal;
+    }
+
+    //scans the input from the given state and returns the state reached. The loop is unrolled by 8,
+    //the dead state is only checked once per 8 bytes
+    uint32_t run(uint32_t state, const char * input, size_t size) const {
+        const uint32_t * table = m_Table;
+        const uint32_t * classes = m_Class;
+        const uint8_t * data = reinterpret_cast<const uint8_t *>(input);
+        const uint8_t * end = data + size;
+
+        while (end - data >= 8) {
+            state = table[state + classes[data[0]]];
+            state = table[state + classes[data[1]]];
+            state = table[state + classes[data[2]]];
+            state = table[state + classes[data[3]]];
+            state = table[state + classes[data[4]]];
+            state = table[state + classes[data[5]]];
+            state = table[state + classes[data[6]]];
+            state = table[state + classes[data[7]]];
+            data += 8;
+            if (state == DEAD) {
+                return DEAD;
+            }
+        }
+        while (data != end) {
+            state = table[state + classes[*data++]];
+        }
+        return state;
+    }
+
+    bool matches(std::string_view input) const {
+        return isFinal(run(m_InitialState, input.data(), input.size()));
+    }
+
+    //matches several independent inputs. The inputs are scanned in lockstep groups, so the table loads
+    //of different streams overlap instead of each waiting for the previous one
+    std::vector<uint8_t> matchMany(const std::vector<std::string_view> & inputs) const {
+        std::vector<uint8_t> result(inputs.size());
+        size_t done = 0;
+#ifdef __AVX2__
+        for (; done + LANES <= inputs.size(); done += LANES) {
+            matchGather(inputs.data() + done, result.data() + done);
+        }
+#endif
+        for (; done + LANES <= inputs.size(); done += LANES) {
+            matchInterleaved(inputs.data() + done, result.data() + done);
+        }
+        for (; done < inputs.size(); done++) {
+            result[done] = matches(inputs[done]);
+        }
+        return result;
+    }
+
+    //matches one large input on several threads. The input is split into one chunk per thread, every chunk
+    //but the first is scanned speculatively from all states it can start in, which yields a mapping from
+    //start states to end states. The mappings are then applied in input order to the end state of the first chunk
+    bool matchesParallel(std::string_view input, const ConversionOptions & options = {}) const {
+        size_t chunks = std::min<size_t>(options.threads(), input.size() / MIN_CHUNK);
+        if (chunks <= 1) {
+            return matches(input);
+        }
+
+        size_t chunkSize = (input.size() + chunks - 1) / chunks;
+        std::vector<ChunkMapping> mappings(chunks);
+        uint32_t state = m_InitialState;
+        parallelFor(chunks, options.threads(), [&](size_t chunk) {
+            std::string_view part = input.substr(chunk * chunkSize, chunkSize);
+            if (chunk == 0) {
+                state = run(m_InitialState, part.data(), part.size());
+            }
+            else {
+                mappings[chunk] = mapChunk(part, input[chunk * chunkSize - 1]);
+            }
+        });
+
+        for (size_t chunk = 1; chunk < chunks; chunk++) {
+            const ChunkMapping & mapping = mappings[chunk];
+            state = mapping.m_End[mapping.m_Run[state / m_Stride]];
+        }
+        return isFinal(state);
+    }
+
+protected:
+    MatcherView() = default;
+
+    void bind(const uint32_t * image) {
+        MatcherHeader header;
+        std::memcpy(&header, image, sizeof(header));
+        m_Class = image + MatcherHeader::WORDS;
+        m_Table = m_Class + 256;
+        m_TableSize = header.m_TableSize;
+        m_Stride = header.m_Stride;
+        m_InitialState = header.m_InitialState;
+        m_FirstFinal = header.m_FirstFinal;
+    }
+
+private:
+    static constexpr size_t LANES = 8;
+    static constexpr size_t MIN_CHUNK = 1 << 16;
+    //distinct runs of a speculative scan are merged after every MERGE_INTERVAL bytes
+    static constexpr size_t MERGE_INTERVAL = 256;
+
+    //end states of a chunk: the run started in the state of row r ends in m_End[m_Run[r]]
+    struct ChunkMapping {
+        std::vector<uint32_t> m_Run;
+        std::vector<uint32_t> m_End;
+    };
+
+    //byte -> column, as uint32_t so that it can be gathered
+    const uint32_t * m_Class = nullptr;
+    const uint32_t * m_Table = nullptr;
+    size_t m_TableSize = 0;
+    uint32_t m_Stride = 1;
+    uint32_t m_InitialState = DEAD;
+    uint32_t m_FirstFinal = 0;
+
+    //scans a chunk from every state it can start in, which are the targets of the byte preceding the chunk.
+    //runs which reach the same state are merged, so after a short prefix usually only one run remains
+    ChunkMapping mapChunk(std::string_view part, unsigned char previous) const {
+        size_t rows = m_TableSize / m_Stride;
+        ChunkMapping mapping;
+        mapping.m_Run.assign(rows, NO_STATE);
+        std::vector<State> merged(rows, NO_STATE);
+
+        auto merge = [&](std::vector<uint32_t> & ends, std::vector<uint32_t> & remap) {
+            std::vector<uint32_t> distinct;
+            for (size_t i = 0; i < ends.size(); i++) {
+                State & index = merged[ends[i] / m_Stride];
+                if (index == NO_STATE) {
+                    index = distinct.size();
+                    distinct.push_back(ends[i]);
+                }
+                remap[i] = index;
+            }
+            for (uint32_t end : distinct) {
+                merged[end / m_Stride] = NO_STATE;
+            }
+            ends.swap(distinct);
+        };
+
+        std::vector<uint32_t> starts(rows);
+        for (size_t row = 0; row < rows; row++) {
+            starts[row] = m_Table[row * m_Stride + m_Class[previous]];
+        }
+        std::vector<uint32_t> remap(rows);
+        mapping.m_End = starts;
+        merge(mapping.m_End, remap);
+        for (size_t row = 0; row < rows; row++) {
+            mapping.m_Run[starts[row] / m_Stride] = remap[row];
+        }
+
+        for (size_t offset = 0; offset < part.size(); offset += MERGE_INTERVAL) {
+            if (mapping.m_End.size() == 1) {
+                mapping.m_End[0] = run(mapping.m_End[0], part.data() + offset, part.size() - offset);
+                break;
+            }
+
+            size_t length = std::min(MERGE_INTERVAL, part.size() - offset);
+            for (uint32_t & end : mapping.m_End) {
+                end = run(end, part.data() + offset, length);
+            }
+
+            size_t runs = mapping.m_End.size();
+            merge(mapping.m_End, remap);
+            if (mapping.m_End.size() != runs) {
+                for (State & index : mapping.m_Run) {
+                    if (index != NO_STATE) {
+                        index = remap[index];
+                    }
+                }
+            }
+        }
+        return mapping;
+    }
+
+    static size_t commonLength(const std::string_view * inputs, size_t count) {
+        size_t length = inputs[0].size();
+        for (size_t lane = 1; lane < count; lane++) {
+            length = std::min(length, inputs[lane].size());
+        }
+        return length;
+    }
+
+    //scans the common prefix of LANES inputs in lockstep, the rest of each input on its own
+    void matchInterleaved(const std::string_view * inputs, uint8_t * result) const {
+        const uint32_t * table = m_Table;
+        const uint8_t * data[LANES];
+        uint32_t states[LANES];
+        for (size_t lane = 0; lane < LANES; lane++) {
+            data[lane] = reinterpret_cast<const uint8_t *>(inputs[lane].data());
+            states[lane] = m_InitialState;
+        }
+
+        size_t length = commonLength(inputs, LANES);
+        for (size_t i = 0; i < length; i++) {
+            for (size_t lane = 0; lane < LANES; lane++) {
+                states[lane] = table[states[lane] + m_Class[data[lane][i]]];
+            }
+        }
+
+        for (size_t lane = 0; lane < LANES; lane++) {
+            result[lane] = isFinal(run(states[lane], inputs[lane].data() + length, inputs[lane].size() - length));
+        }
+    }
+
+#ifdef __AVX2__
+    //one step of 8 streams is a gather of the classes and a gather of the targets. Each stream's next 4 bytes
+    //are loaded at once and fed to 4 consecutive steps. Only compiled in with -mavx2, on CPUs with slow gathers
+    //the scalar interleaving is just as fast
+    void matchGather(const std::string_view * inputs, uint8_t * result) const {
+        const int * table = reinterpret_cast<const int *>(m_Table);
+        const int * classes = reinterpret_cast<const int *>(m_Class);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        __m256i states = _mm256_set1_epi32(m_InitialState);
+
+        size_t length = commonLength(inputs, LANES) & ~size_t(3);
+        for (size_t i = 0; i < length; i += 4) {
+            uint32_t words[LANES];
+            for (size_t lane = 0; lane < LANES; lane++) {
+                std::memcpy(&words[lane], inputs[lane].data() + i, sizeof(uint32_t));
+            }
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words));
+            for (int shift = 0; shift < 32; shift += 8) {
+                __m256i symbols = _mm256_and_si256(_mm256_srli_epi32(bytes, shift), byteMask);
+                __m256i columns = _mm256_i32gather_epi32(classes, symbols, 4);
+                states = _mm256_i32gather_epi32(table, _mm256_add_epi32(states, columns), 4);
+            }
+        }
+
+        uint32_t lanes[LANES];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), states);
+        for (size_t lane = 0; lane < LANES; lane++) {
+            result[lane] = isFinal(run(lanes[lane], inputs[lane].data() + length, inputs[lane].size() - length));
+        }
+    }
+#endif
+};
+
+//DFA compiled for matching, owns its image
+class CompiledDFA : public MatcherView {
+public:
+    //state IDs must fit into the signed 32 bit indices of the gathers
+    static constexpr size_t MAX_TABLE = (size_t(1) << 31) - 1;
+
+    explicit CompiledDFA(const DenseDFA & dfa)
+            : m_Image(compile(dfa)) {
+        bind(m_Image.data());
+    }
+
+    explicit CompiledDFA(const DFA & dfa)
+            : CompiledDFA(toDense(dfa)) {
+    }
+
+    CompiledDFA(const CompiledDFA & other)
+            : MatcherView(other),
+              m_Image(other.m_Image) {
+        bind(m_Image.data());
+    }
+
+    //moving the vector keeps its buffer, so the view stays valid
+    CompiledDFA(CompiledDFA && other) noexcept = default;
+
+    CompiledDFA & operator=(CompiledDFA other) noexcept {
+        m_Image.swap(other.m_Image);
+        bind(m_Image.data());
+        return *this;
+    }
+
+    const std::vector<uint32_t> & image() const {
+        return m_Image;
+    }
+
+private:
+    static std::vector<uint32_t> compile(const DenseDFA & dfa) {
+        MatcherHeader header = {};
+        header.m_Magic = MatcherHeader::MAGIC;
+        header.m_Version = MatcherHeader::VERSION;
+        header.m_ByteOrder = MatcherHeader::ORDER_MARK;
+        header.m_Stride = dfa.columns() + 1;
+        //computed in size_t, with 256 symbol classes the 32-bit product wraps above 16.7M states
+        if ((size_t(dfa.m_StateCount) + 1) * header.m_Stride > MAX_TABLE) {
+            throw std::length_error("CompiledDFA: too many states");
+        }
+
+        std::vector<uint8_t> live = coaccessibleStates(dfa);
+        std::vector<uint32_t> id(dfa.m_StateCount, DEAD);
+        uint32_t next = header.m_Stride;
+        for (uint8_t final = 0; final <= 1; final++) {
+            if (final) {
+                header.m_FirstFinal = next;
+            }
+            for (State state = 0; state < dfa.m_StateCount; state++) {
+                if (live[state] && dfa.m_Final[state] == final) {
+                    id[state] = next;
+                    next += header.m_Stride;
+                }
+            }
+        }
+        header.m_TableSize = next;
+        header.m_InitialState = dfa.m_StateCount != 0 ? id[dfa.m_InitialState] : DEAD;
+
+        std::vector<uint32_t> image(MatcherHeader::WORDS + 256 + header.m_TableSize, DEAD);
+        std::memcpy(image.data(), &header, sizeof(header));
+        uint32_t * classes = image.data() + MatcherHeader::WORDS;
+        for (size_t byte = 0; byte < 256; byte++) {
+            uint16_t column = dfa.m_Alphabet.m_Column[byte];
+            classes[byte] = column != NO_COLUMN ? column : dfa.columns();
+        }
+
+        uint32_t * table = classes + 256;
+        for (State state = 0; state < dfa.m_StateCount; state++) {
+            if (!live[state]) {
+                continue;
+            }
+            for (size_t column = 0; column < dfa.columns(); column++) {
+                State target = dfa.next(state, column);
+                if (target != NO_STATE) {
+                    table[id[state] + column] = id[target];
+                }
+            }
+        }
+
+        return image;
+    }
+
+    std::vector<uint32_t> m_Image;
+};
+
+//writes the image of a compiled DFA to a file, which can be mapped back by MappedDFA
+void saveMatcher(const CompiledDFA & dfa, const std::string & path) {
+    std::unique_ptr<FILE, int (*)(FILE *)> file(std::fopen(path.c_str(), "wb"), std::fclose);
+    if (!file) {
+        throw std::runtime_error("saveMatcher: cannot open " + path);
+    }
+    const std::vector<uint32_t> & image = dfa.image();
+    if (std::fwrite(image.data(), sizeof(uint32_t), image.size(), file.get()) != image.size()
+        || std::fflush(file.get()) != 0) {
+        throw std::runtime_error("saveMatcher: cannot write " + path);
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+//compiled DFA matched directly out of a read-only mapping of a file written by saveMatcher.
+//nothing is copied or deserialized, the pages are loaded on demand and shared by all processes mapping the file.
+//the constructor only checks the header and the size of the file, verify() also checks every transition
+class MappedDFA : public MatcherView {
+public:
+    explicit MappedDFA(const std::string & path) {
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::runtime_error("MappedDFA: cannot open " + path);
+        }
+
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0) {
+            ::close(descriptor);
+            throw std::runtime_error("MappedDFA: cannot stat " + path);
+        }
+        m_Size = status.st_size;
+
+        void * mapping = m_Size != 0 ? ::mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+        ::close(descriptor);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("MappedDFA: cannot map " + path);
+        }
+        m_Mapping = static_cast<const uint32_t *>(mapping);
+
+        if (m_Size >= sizeof(MatcherHeader) && header().m_ByteOrder == MatcherHeader::SWAPPED_ORDER_MARK) {
+            ::munmap(mapping, m_Size);
+            throw std::runtime_error("MappedDFA: " + path + " was compiled on a machine of the other byte order");
+        }
+        if (!checkHeader()) {
+            ::munmap(mapping, m_Size);
+            throw std::runtime_error("MappedDFA: " + path + " is not a compiled DFA of version "
+                                     + std::to_string(MatcherHeader::VERSION));
+        }
+        bind(m_Mapping);
+    }
+
+    MappedDFA(const MappedDFA &) = delete;
+    MappedDFA & operator=(const MappedDFA &) = delete;
+
+    ~MappedDFA() {
+        ::munmap(const_cast<uint32_t *>(m_Mapping), m_Size);
+    }
+
+private:
+    MatcherHeader header() const {
+        MatcherHeader header;
+        std::memcpy(&header, m_Mapping, sizeof(header));
+        return header;
     }
 
-    for (auto symbol : automaton.m_Alphabet) {
-        if (map[automaton.m_Transitions[{state, symbol}]] != map[automaton.m_Transitions[{first, symbol}]]) {
+    bool checkHeader() const {
+        if (m_Size < sizeof(MatcherHeader)) {
             return false;
         }
+        MatcherHeader header = this->header();
+        return header.m_Magic == MatcherHeader::MAGIC && header.m_Version == MatcherHeader::VERSION
+               && header.m_ByteOrder == MatcherHeader::ORDER_MARK
+               && header.m_Stride != 0 && header.m_TableSize >= header.m_Stride
+               && header.m_TableSize % header.m_Stride == 0
+               && header.m_InitialState < header.m_TableSize && header.m_InitialState % header.m_Stride == 0
+               && m_Size == (MatcherHeader::WORDS + 256 + size_t(header.m_TableSize)) * sizeof(uint32_t);
     }
 
-    return true;
-}
+    const uint32_t * m_Mapping = nullptr;
+    size_t m_Size = 0;
+};
+#endif
 
-DFA minimize(DFA original) {
-    DFA result;
+//matches a stream which arrives in several buffers. Only the current state is kept between the buffers,
+//which are scanned in place. Once the dead state is entered the stream can never be accepted,
+//further input is ignored and the caller can stop reading
+class StreamMatcher {
+public:
+    explicit StreamMatcher(const MatcherView & dfa)
+            : m_DFA(dfa),
+              m_State(dfa.initialState()) {
+    }
 
-    //create set of non-final states by using {States}\{FinalStates} (difference of sets)
-    std::set<State> Q1;
-    std::set_difference(original.m_States.begin(), original.m_States.end(),
-                        original.m_FinalStates.begin(), original.m_FinalStates.end(),
-                        std::inserter(Q1, Q1.begin()));
+    //returns false if the stream is dead
+    bool feed(const uint8_t * data, size_t size) {
+        return feed(std::string_view(reinterpret_cast<const char *>(data), size));
+    }
 
-    //create set of final states
-    std::set<State> Q2 = original.m_FinalStates;
+    bool feed(std::string_view buffer) {
+        if (m_State != MatcherView::DEAD) {
+            m_State = m_DFA.run(m_State, buffer.data(), buffer.size());
+            m_Consumed += buffer.size();
+        }
+        return m_State != MatcherView::DEAD;
+    }
 
-    //create a map which maps the state to the equivalency set it is in
-    std::map<State, State> stateSetID;
-    for (auto i : Q1) {
-        stateSetID[i] = 0;
+    //whether the input fed so far is accepted
+    bool accepting() const {
+        return m_DFA.isFinal(m_State);
     }
-    for (auto i : Q2) {
-        stateSetID[i] = 1;
+
+    bool dead() const {
+        return m_State == MatcherView::DEAD;
     }
 
-    //create 2 vectors of sets. Each set will be a set of equivalent states. The algorithm stops when they are equal
-    std::vector<std::set<State>> currSet = {Q1, Q2};
-    std::vector<std::set<State>> prevSet;
+    //bytes of the buffers fed while the stream was alive
+    size_t consumed() const {
+        return m_Consumed;
+    }
 
-    while (currSet != prevSet) {
-        //set the previous set to the current set, since we will be modifying the current set now.
-        prevSet = currSet;
+    void reset() {
+        m_State = m_DFA.initialState();
+        m_Consumed = 0;
+    }
 
-        for (size_t i = 0; i < currSet.size(); i++) {
-            //create temporary equivalence set where all states that do not match current equivalence set will go
-            std::set<State> tmpEquivalenceSet;
+private:
+    const MatcherView & m_DFA;
+    uint32_t m_State;
+    size_t m_Consumed = 0;
+};
 
-            //check every state in the equivalence set and compare it with the first element in the equivalence set
-            for (auto state = currSet[i].begin(); state != currSet[i].end();) {
-                //move all states that are not equivalent with the head of the set into their own new set
-                if (!equivalentWithSet(*state, currSet[i], stateSetID, original)) {
-                    tmpEquivalenceSet.insert(*state);
-                    state++;
-                }
-                else {
-                    state++;
-                }
-            }
+//matches text directly against an NFA, determinizing it lazily while scanning. Subsets are created on demand
+//by the successor logic of determine() and cached together with their transitions. The cache is bounded:
+//when it is full, it is flushed and the scan continues from the current subset. If flushes come after
+//fewer than MIN_BYTES_PER_STATE scanned bytes per cached state, caching does not pay off and the rest
+//of the input is matched by simulating the NFA on bitsets
+class LazyDFAMatcher {
+public:
+    static constexpr size_t DEFAULT_CACHE_LIMIT = 8 << 20;
+    static constexpr size_t MIN_BYTES_PER_STATE = 10;
 
-            if (!tmpEquivalenceSet.empty()) {
-                for (auto j : tmpEquivalenceSet) {
-                    stateSetID[j] = currSet.size();
-                    currSet[i].erase(j);
-                }
-                currSet.push_back(tmpEquivalenceSet);
-            }
-        }
+    explicit LazyDFAMatcher(DenseNFA nfa, size_t cacheLimit = DEFAULT_CACHE_LIMIT)
+            : m_NFA(std::move(nfa)),
+              m_Lazy(m_NFA),
+              m_CacheLimit(cacheLimit),
+              m_Current(m_Lazy.words()),
+              m_Buffer(m_Lazy.words()) {
     }
 
-    //give states new state IDs based on their equivalency set
-    //(states in the same equivalency set have the same ID)
-    std::map<State, State> newStateMapping;
-    std::map<std::set<State>, State> setMapping;
-    State counter = 0;
-    for (auto & set : currSet) {
-        setMapping[set] = counter;
-        for (auto state : set) {
-            newStateMapping[state] = counter;
-        }
-        ++counter;
+    explicit LazyDFAMatcher(const NFA & nfa, size_t cacheLimit = DEFAULT_CACHE_LIMIT)
+            : LazyDFAMatcher(toDense(nfa), cacheLimit) {
     }
 
-    for (auto & set : currSet) {
-        if (set.find(original.m_InitialState) != set.end()) {
-            result.m_InitialState = setMapping[set];
-        }
+    //m_Lazy refers to m_NFA
+    LazyDFAMatcher(const LazyDFAMatcher &) = delete;
+    LazyDFAMatcher & operator=(const LazyDFAMatcher &) = delete;
 
-        result.m_States.insert(setMapping[set]);
+    size_t cachedStates() const {
+        return m_Lazy.size();
+    }
 
-        if (original.m_FinalStates.find(*set.begin()) != original.m_FinalStates.end()) {
-            result.m_FinalStates.insert(setMapping[set]);
-        }
+    size_t flushes() const {
+        return m_Flushes;
+    }
+
+    size_t bytes() const {
+        return m_NFA.bytes() + m_Lazy.successors().bytes() + m_Lazy.bytes();
+    }
+
+    bool matches(std::string_view input) {
+        const uint8_t * data = reinterpret_cast<const uint8_t *>(input.data());
+        const uint8_t * end = data + input.size();
+        const uint8_t * scannedFrom = data;
+        State state = 0;
 
-        for (auto symbol : original.m_Alphabet) {
-            auto findTransition = original.m_Transitions.find({*set.begin(), symbol});
-            if (findTransition != original.m_Transitions.end()) {
-                result.m_Transitions[{setMapping[set], symbol}] = newStateMapping[findTransition->second];
+        for (; data != end; data++) {
+            if (m_Lazy.isEmpty(state)) {
+                return false;
+            }
+            uint16_t column = m_NFA.m_Alphabet.m_Column[*data];
+            if (column == NO_COLUMN) {
+                return false;
+            }
+
+            State target = m_Lazy.cached(state, column);
+            if (target == NO_STATE) {
+                if (m_Lazy.usedBytes() > m_CacheLimit) {
+                    m_Scanned += data - scannedFrom;
+                    scannedFrom = data;
+                    if (m_Scanned < MIN_BYTES_PER_STATE * m_Lazy.size()) {
+                        return simulate(state, data, end);
+                    }
+                    state = flush(state);
+                }
+                target = m_Lazy.next(state, column);
             }
+            state = target;
         }
+
+        m_Scanned += end - scannedFrom;
+        return m_Lazy.isFinal(state);
     }
 
-    result.m_Alphabet = original.m_Alphabet;
+private:
+    //empties the cache, keeping only the initial subset (always state 0) and the given one
+    State flush(State keep) {
+        m_Flushes++;
+        m_Scanned = 0;
+        return m_Lazy.clear(keep);
+    }
 
-    for (auto i : result.m_States) {
-        bool isSink = true;
+    //matches the rest of the input without the cache, starting from the given subset
+    bool simulate(State state, const uint8_t * data, const uint8_t * end) {
+        const SubsetSuccessors & successors = m_Lazy.successors();
+        m_Lazy.subset(state, m_Current);
 
-        for (auto j : result.m_Alphabet) {
-            if (result.m_Transitions[{i, j}] != i || result.m_FinalStates.find(i) != result.m_FinalStates.end()) {
-                isSink = false;
-                break;
+        for (; data != end; data++) {
+            uint16_t column = m_NFA.m_Alphabet.m_Column[*data];
+            if (column == NO_COLUMN) {
+                return false;
+            }
+            successors.successors(m_Current, column, m_Buffer);
+            std::swap(m_Current, m_Buffer);
+            if (m_Current.empty()) {
+                return false;
             }
         }
+        return successors.isFinal(m_Current);
+    }
+
+    DenseNFA m_NFA;
+    LazyDeterminization m_Lazy;
+    size_t m_CacheLimit;
+    size_t m_Flushes = 0;
+    //bytes scanned since the last flush
+    size_t m_Scanned = 0;
+    //scratch subsets of simulate()
+    SubsetBuffer m_Current;
+    SubsetBuffer m_Buffer;
+};
 
-        if (isSink) {
-            result.m_States.erase(i);
-            auto transition = result.m_Transitions.begin();
-            while (transition != result.m_Transitions.end()) {
-                if (transition->first.first == i || transition->second == i) {
-                    transition = result.m_Transitions.erase(transition);
+//simulation of an NFA with at most 64 * WORDS states, the set of active states is a bitset of WORDS words.
+//successors are precomputed per column and per nibble of the bitset: entry `bits` of the table of a nibble
+//is the union of the successors of the states selected by the 4 bits. One input byte then costs at most
+//16 * WORDS lookups and word-wide ORs, no matter how many states are active
+template <size_t WORDS>
+class BitParallelNFA {
+public:
+    using Mask = std::array<uint64_t, WORDS>;
+    static constexpr size_t MAX_STATES = 64 * WORDS;
+    static constexpr size_t NIBBLES = MAX_STATES / 4;
+
+    explicit BitParallelNFA(const DenseNFA & nfa)
+            : m_Column(nfa.m_Alphabet.m_Column),
+              m_Initial(),
+              m_Final(),
+              m_Table(nfa.columns() * NIBBLES * 16, Mask()) {
+        assert(nfa.m_StateCount <= MAX_STATES);
+        setBit(m_Initial, nfa.m_InitialState);
+
+        for (State state = 0; state < nfa.m_StateCount; state++) {
+            if (nfa.m_Final[state]) {
+                setBit(m_Final, state);
+            }
+            for (size_t column = 0; column < nfa.columns(); column++) {
+                Mask successors = {};
+                for (auto target = nfa.begin(state, column); target != nfa.end(state, column); target++) {
+                    setBit(successors, *target);
                 }
-                else {
-                    transition++;
+
+                Mask * nibble = table(column) + state / 4 * 16;
+                for (unsigned bits = 0; bits < 16; bits++) {
+                    if (bits & (1 << state % 4)) {
+                        for (size_t word = 0; word < WORDS; word++) {
+                            nibble[bits][word] |= successors[word];
+                        }
+                    }
                 }
             }
-            break;
         }
     }
 
-    if (result.m_States.find(result.m_InitialState) == result.m_States.end()) {
-        result.m_InitialState = *result.m_States.begin();
+    size_t bytes() const {
+        return m_Table.capacity() * sizeof(Mask);
     }
 
-    bool restInaccessible = true;
-    for (auto symbol : result.m_Alphabet) {
-        auto tr = result.m_Transitions.find({result.m_InitialState, symbol});
-        if (tr != result.m_Transitions.end() && tr->second != result.m_InitialState) {
-            restInaccessible = false;
-        }
-    }
+    bool matches(std::string_view input) const {
+        Mask active = m_Initial;
 
-    if (restInaccessible) {
-        result.m_States = {result.m_InitialState};
-        auto i = result.m_Transitions.begin();
-        while (i != result.m_Transitions.end()) {
-            if (i->first.first != result.m_InitialState) {
-                i = result.m_Transitions.erase(i);
+        for (unsigned char byte : input) {
+            uint16_t column = m_Column[byte];
+            if (column == NO_COLUMN) {
+                return false;
             }
-            else {
-                i++;
+
+            const Mask * nibbles = table(column);
+            Mask next = {};
+            uint64_t any = 0;
+            for (size_t word = 0; word < WORDS; word++) {
+                const Mask * nibble = nibbles + word * 16 * 16;
+                for (uint64_t bits = active[word]; bits != 0; bits >>= 4, nibble += 16) {
+                    const Mask & successors = nibble[bits & 15];
+                    for (size_t i = 0; i < WORDS; i++) {
+                        next[i] |= successors[i];
+                    }
+                }
+            }
+            for (size_t word = 0; word < WORDS; word++) {
+                any |= next[word];
+            }
+            if (any == 0) {
+                return false;
             }
+            active = next;
         }
+
+        for (size_t word = 0; word < WORDS; word++) {
+            if (active[word] & m_Final[word]) {
+                return true;
+            }
+        }
+        return false;
     }
 
-    return result;
-}
+private:
+    static void setBit(Mask & mask, State state) {
+        mask[state / 64] |= uint64_t(1) << (state % 64);
+    }
 
-//removes unreachable states, adds sink state if necessary
-DFA determine(const NFA & nfa) {
-    DFA result;
+    const Mask * table(size_t column) const {
+        return m_Table.data() + column * NIBBLES * 16;
+    }
 
-    //copy alphabet and initial state, since they will always be the same
-    result.m_Alphabet = nfa.m_Alphabet;
-    result.m_InitialState = 0;
+    Mask * table(size_t column) {
+        return m_Table.data() + column * NIBBLES * 16;
+    }
 
-    //map of set of states to their new state ID
-    std::map<std::set<State>, unsigned int> map;
-    //stack of states which need to be added
-    std::queue<std::set<State>> queue;
+    std::array<uint16_t, 256> m_Column;
+    Mask m_Initial;
+    Mask m_Final;
+    std::vector<Mask> m_Table;
+};
 
-    //counter of total new states
-    size_t stateCounter = 0;
+//matches text against an NFA of up to MAX_STATES states without determinizing it,
+//using the narrowest BitParallelNFA the NFA fits into
+class SmallNFAMatcher {
+public:
+    static constexpr size_t MAX_STATES = BitParallelNFA<4>::MAX_STATES;
 
-    //manually add 1st state
-    result.m_States.insert(0);
-    map[{nfa.m_InitialState}] = 0;
+    static bool fits(const NFA & nfa) {
+        return nfa.m_States.size() <= MAX_STATES;
+    }
 
-    //check if manually inserted first state is final, and add it to final states set
-    if (nfa.m_FinalStates.find(nfa.m_InitialState) != nfa.m_FinalStates.end()) {
-        result.m_FinalStates.insert(0);
+    explicit SmallNFAMatcher(const DenseNFA & nfa)
+            : m_Engine(select(nfa)) {
     }
-    ++stateCounter;
 
-    bool sinkStateAdded = false;
+    explicit SmallNFAMatcher(const NFA & nfa)
+            : SmallNFAMatcher(toDense(nfa)) {
+    }
 
-    //get all transitions for start state and write them down as a grouped transition
-    for (auto & symbol : nfa.m_Alphabet) {
-        //find transition with starting state 0 and symbol i (i cycles through entire alphabet)
-        auto startState = nfa.m_Transitions.find({nfa.m_InitialState, symbol});
+    size_t bytes() const {
+        return std::visit([](const auto & engine) { return engine.bytes(); }, m_Engine);
+    }
 
-        //if matching transition is found
-        if (startState != nfa.m_Transitions.end()) {
-            //if this exact transition did not exist before
-            if (map.find(startState->second) == map.end()) {
-                //add this transition to stack so that it can be reviewed again
-                queue.push(startState->second);
+    bool matches(std::string_view input) const {
+        return std::visit([&](const auto & engine) { return engine.matches(input); }, m_Engine);
+    }
 
-                //remember this transition with it's unique ID being the current stateCounter
-                map[startState->second] = stateCounter;
-                //increase the total number of states (and help assign new IDs)
-                ++stateCounter;
+private:
+    using Engine = std::variant<BitParallelNFA<1>, BitParallelNFA<2>, BitParallelNFA<4>>;
 
-                //assign ID to this new transition in the result DFA
-                result.m_States.insert(map[startState->second]);
-            }
-            result.m_Transitions[{0, symbol}] = map[startState->second];
+    static Engine select(const DenseNFA & nfa) {
+        if (nfa.m_StateCount <= BitParallelNFA<1>::MAX_STATES) {
+            return BitParallelNFA<1>(nfa);
         }
-        else {
-            if (!sinkStateAdded) {
-                queue.push({});
-                map[{}] = stateCounter;
-
-                result.m_States.insert(stateCounter);
-                result.m_Transitions[{0, symbol}] = stateCounter;
-                stateCounter++;
-                sinkStateAdded = true;
-            }
-            else {
-                result.m_Transitions[{0, symbol}] = map[{}];
-            }
+        if (nfa.m_StateCount <= BitParallelNFA<2>::MAX_STATES) {
+            return BitParallelNFA<2>(nfa);
+        }
+        if (nfa.m_StateCount <= BitParallelNFA<4>::MAX_STATES) {
+            return BitParallelNFA<4>(nfa);
         }
+        throw std::length_error("SmallNFAMatcher: too many states");
     }
 
-    //while there are still transitions left to review
-    while (!queue.empty()) {
-        //get next element in queue of non-computed transitions
-        auto nextInQueue = queue.front();
+    Engine m_Engine;
+};
 
-        //set flag to determine if state is accepting or not
-        bool flag = false;
+#ifndef __PROGTEST__
 
-        //for every state inside the current state set at the top of the stack
-        //this basically makes it so that all the states in the set behave like 1 state by unifying their transitions
-        for (auto symbol : nfa.m_Alphabet) {
-            //create a temporary set to store states transitioned to, from the nextInQueue
-            std::set<State> tmp;
+#include <filesystem>
+#include <random>
 
-            for (auto state : nextInQueue) {
-                //check if this state we are checking is an accepting state and set the flag accordingly
-                if (flag != true && nfa.m_FinalStates.find(state) != nfa.m_FinalStates.end()) {
-                    flag = true;
-                }
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
 
-                //find transitions with current state and every symbol in the alphabet and determine if they exist
-                auto transitionSet = nfa.m_Transitions.find({state, symbol});
+//DFAs are compared in their canonical form, so the comparison does not depend on the state naming strategy
+bool operator==(const DFA& a, const DFA& b)
+{
+    DFA x = canonicalForm(a);
+    DFA y = canonicalForm(b);
+    return std::tie(x.m_States, x.m_Alphabet, x.m_Transitions, x.m_InitialState, x.m_FinalStates) == std::tie(y.m_States, y.m_Alphabet, y.m_Transitions, y.m_InitialState, y.m_FinalStates);
+}
 
-                if (transitionSet != nfa.m_Transitions.end()) {
-                    tmp.insert(transitionSet->second.begin(), transitionSet->second.end());
-                }
-            }
+//every heap allocation of the test binary is counted, so benchmarks can report allocations per operation.
+//all the plain, nothrow and aligned forms are replaced (the arenas get their chunks through the aligned ones),
+//so every allocation is freed by the matching allocator
+static std::atomic<size_t> allocationCount{0};
 
-            //if this newly created state wasn't looked at before, add it to the queue of states to be checked.
-            //also, make it into a new state and add it.
-            if (map.find(tmp) == map.end()) {
-                //remember this transition with it's unique ID being the current stateCounter
-                map[tmp] = stateCounter;
-                //increase the total number of states (and help assign new IDs)
-                ++stateCounter;
+__attribute__((noinline)) void * operator new(size_t size, const std::nothrow_t &) noexcept {
+    ++allocationCount;
+    return std::malloc(size != 0 ? size : 1);
+}
 
-                //add newly created transition to queue
-                queue.push(tmp);
-            }
+__attribute__((noinline)) void * operator new(size_t size) {
+    if (void * memory = operator new(size, std::nothrow)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
 
-            //assign ID to this new transition in the result DFA
-            result.m_Transitions[{map[nextInQueue], symbol}] = map[tmp];
-            //insert state ID into result set of states
-            result.m_States.insert(map[tmp]);
+void * operator new[](size_t size) {
+    return operator new(size);
+}
 
-            //if the state was determined to be accepting by the flag previously, add it as an accepting state now.
-            if (flag) {
-                result.m_FinalStates.insert(map[nextInQueue]);
-            }
-        }
-        queue.pop();
-    }
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
 
-    return result;
+__attribute__((noinline)) void operator delete(void * memory) noexcept {
+    std::free(memory);
 }
 
-NFA unifyNFA(const NFA & a, const NFA & b) {
-    //create new temporary result NFA as copy of a
-    NFA result = a;
-    result.m_Alphabet.insert(b.m_Alphabet.begin(), b.m_Alphabet.end());
+__attribute__((noinline)) void operator delete(void * memory, size_t) noexcept {
+    std::free(memory);
+}
 
-    //add all states from b and offset them by the size of a because the states are now concurrent
-    for (auto state : b.m_States) {
-        result.m_States.insert(state + a.m_States.size());
-        if (b.m_FinalStates.find(state) != b.m_FinalStates.end()) {
-            result.m_FinalStates.insert(state + a.m_States.size());
-        }
+void operator delete(void * memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
 
-        for (auto symbol : b.m_Alphabet) {
-            //check if transition for this state and symbol exists
-            auto transition = b.m_Transitions.find({state, symbol});
+void operator delete[](void * memory) noexcept {
+    std::free(memory);
+}
 
-            if (transition != b.m_Transitions.end()) {
-                //offset all elements in resulting transition to account for states in NFA a
-                for (auto & elem : transition->second) {
-                    //add resulting state for this transition from b and offset result as well since all states
-                    //in b are offset
-                    result.m_Transitions[{state + a.m_States.size(), symbol}]
-                            .insert(elem + a.m_States.size());
-                }
-            }
-        }
-    }
+void operator delete[](void * memory, size_t) noexcept {
+    std::free(memory);
+}
 
-    //create new start state for union of languages
-    result.m_InitialState = result.m_States.size();
-    result.m_States.insert(result.m_InitialState);
+void operator delete[](void * memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+__attribute__((noinline)) void * operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    ++allocationCount;
+    //aligned_alloc needs a size which is a multiple of the alignment
+    size_t align = static_cast<size_t>(alignment);
+    return std::aligned_alloc(align, size != 0 ? (size + align - 1) / align * align : align);
+}
 
-    if (a.m_FinalStates.find(a.m_InitialState) != a.m_FinalStates.end() || b.m_FinalStates.find(b.m_InitialState) != b.m_FinalStates.end()) {
-        result.m_FinalStates.insert(result.m_InitialState);
+__attribute__((noinline)) void * operator new(size_t size, std::align_val_t alignment) {
+    if (void * memory = operator new(size, alignment, std::nothrow)) {
+        return memory;
     }
+    throw std::bad_alloc();
+}
+
+void * operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void * operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void * memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void * memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void * memory, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void * memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void * memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void * memory, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
 
-    //check all transitions from initial states for every symbol in the alphabet
-    for (auto symbol : result.m_Alphabet) {
-        //do not forget to offset states in NFA b
-        auto trA = a.m_Transitions.find({a.m_InitialState, symbol});
-        auto trB = b.m_Transitions.find({b.m_InitialState, symbol});
+//peak resident set size of the whole process so far in KiB, 0 where getrusage() is not available
+long processPeakRSS() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+//random NFA over the symbols 'a', 'b', ..., every state has on average `density` targets per symbol
+NFA randomNFA(std::mt19937 & random, State states, unsigned symbols, double density) {
+    NFA result;
+    std::binomial_distribution<unsigned> targets(states, std::min(1.0, density / states));
+    std::uniform_int_distribution<State> state(0, states - 1);
 
-        if (trA != a.m_Transitions.end()) {
-            result.m_Transitions[{result.m_InitialState, symbol}] = trA->second;
+    for (State i = 0; i < states; i++) {
+        result.m_States.insert(i);
+        if (random() % 4 == 0) {
+            result.m_FinalStates.insert(i);
         }
+    }
+    for (unsigned i = 0; i < symbols; i++) {
+        result.m_Alphabet.insert('a' + i);
+    }
 
-        if (trB != b.m_Transitions.end()) {
-            for (auto state : trB->second) {
-                result.m_Transitions[{result.m_InitialState, symbol}].insert(state + a.m_States.size());
+    for (State i = 0; i < states; i++) {
+        for (auto symbol : result.m_Alphabet) {
+            std::set<State> transition;
+            for (unsigned count = targets(random); count > 0; count--) {
+                transition.insert(state(random));
+            }
+            if (!transition.empty()) {
+                result.m_Transitions[{i, symbol}] = transition;
             }
         }
     }
+    result.m_InitialState = 0;
 
     return result;
 }
 
-DFA unify(const NFA& a, const NFA& b) {
-    return minimize(determine(unifyNFA(a, b)));
-}
-
-DFA parallelRun(const DFA & a, const DFA & b) {
-    DFA result;
-    result.m_Alphabet.insert(a.m_Alphabet.begin(), a.m_Alphabet.end());
-    result.m_Alphabet.insert(b.m_Alphabet.begin(), b.m_Alphabet.end());
+//large sparse NFA shaped like a chain of two lanes: states 2i and 2i + 1 are position i, symbol '0' moves to both
+//lanes of the next position from lane 0 and stays in the lane otherwise, symbol '1' moves to lane 0.
+//every subset holds at most two neighbouring states, so it has at most 3 * length + 1 of them
+NFA laneChain(State length) {
+    NFA result;
+    result.m_Alphabet = {'0', '1'};
+    result.m_InitialState = 0;
+    result.m_FinalStates = {2 * length + 1};
 
-    std::map<std::pair<std::vector<State>, Symbol>, std::vector<State>> tempTransitions;
-    std::map<std::vector<State>, State> pairID;
-    std::queue<std::vector<State>> queue;
+    for (State i = 0; i < 2 * length + 2; i++) {
+        result.m_States.insert(i);
+    }
+    for (State i = 0; i < length; i++) {
+        result.m_Transitions[{2 * i, '0'}] = {2 * i + 2, 2 * i + 3};
+        result.m_Transitions[{2 * i + 1, '0'}] = {2 * i + 3};
+        result.m_Transitions[{2 * i, '1'}] = {2 * i + 2};
+        result.m_Transitions[{2 * i + 1, '1'}] = {2 * i + 2};
+    }
 
-    //state with ID 0 will always be sink state.
-    pairID[{}] = 0;
+    return result;
+}
 
-    //add sink state to the resulting DFA.
-    result.m_States.insert(0);
+//NFA over {'0', '1'} accepting words whose n-th symbol from the end is '1', its minimal DFA has 2^n states
+NFA nthFromEnd(unsigned n) {
+    NFA result;
+    result.m_Alphabet = {'0', '1'};
+    result.m_InitialState = 0;
+    result.m_FinalStates = {n};
 
-    //sink state will always transition to itself.
-    for (auto symbol : result.m_Alphabet) {
-        tempTransitions[{{}, symbol}] = {};
+    for (State i = 0; i <= n; i++) {
+        result.m_States.insert(i);
+    }
+    result.m_Transitions[{0, '0'}] = {0};
+    result.m_Transitions[{0, '1'}] = {0, 1};
+    for (State i = 1; i < n; i++) {
+        result.m_Transitions[{i, '0'}] = {i + 1};
+        result.m_Transitions[{i, '1'}] = {i + 1};
     }
 
-    //since initial states are pushed first, resulting DFA initial state will always be 1
-    result.m_InitialState = 1;
-
-    State stateCounter = 1;
-    queue.push({a.m_InitialState, b.m_InitialState});
+    return result;
+}
 
-    while (!queue.empty()) {
-        auto next = queue.front();
-        queue.pop();
+//random DFA where every state has transitions on `degree` random symbols out of `symbols`
+DFA sparseDFA(std::mt19937 & random, State states, unsigned symbols, unsigned degree) {
+    DFA result;
+    std::uniform_int_distribution<State> state(0, states - 1);
+    std::uniform_int_distribution<unsigned> symbol(0, symbols - 1);
 
-        for (auto symbol : result.m_Alphabet) {
-            if (next.size() == 2) {
-                auto transitionA = a.m_Transitions.find({next[0], symbol});
-                auto transitionB = b.m_Transitions.find({next[1], symbol});
+    for (State i = 0; i < states; i++) {
+        result.m_States.insert(i);
+        if (random() % 4 == 0) {
+            result.m_FinalStates.insert(i);
+        }
+        for (unsigned j = 0; j < degree; j++) {
+            result.m_Transitions[{i, Symbol('a' + symbol(random))}] = state(random);
+        }
+    }
+    for (unsigned i = 0; i < symbols; i++) {
+        result.m_Alphabet.insert('a' + i);
+    }
+    result.m_InitialState = 0;
 
-                if (transitionA != a.m_Transitions.end() && transitionB != b.m_Transitions.end()) {
-                    tempTransitions[{{next[0], next[1]}, symbol}] = {transitionA->second, transitionB->second};
+    return result;
+}
 
-                    if (pairID.find({next[0], next[1]}) == pairID.end()) {
-                        pairID[{next[0], next[1]}] = stateCounter;
+//the NFA with the transitions of the DFA
+NFA asNFA(const DFA & dfa) {
+    NFA result{dfa.m_States, dfa.m_Alphabet, {}, dfa.m_InitialState, dfa.m_FinalStates};
+    for (auto & transition : dfa.m_Transitions) {
+        result.m_Transitions[transition.first] = {transition.second};
+    }
+    return result;
+}
 
-                        result.m_States.insert(stateCounter);
+//simulation on sets of states, independent of all the conversions
+bool accepts(const NFA & nfa, std::string_view word) {
+    std::set<State> current = {nfa.m_InitialState};
+    for (unsigned char symbol : word) {
+        std::set<State> next;
+        for (auto state : current) {
+            auto found = nfa.m_Transitions.find({state, symbol});
+            if (found != nfa.m_Transitions.end()) {
+                next.insert(found->second.begin(), found->second.end());
+            }
+        }
+        current.swap(next);
+    }
+    return std::any_of(current.begin(), current.end(), [&](State state) { return nfa.m_FinalStates.count(state) != 0; });
+}
 
-                        if (a.m_FinalStates.find({next[0]}) != a.m_FinalStates.end()
-                            && b.m_FinalStates.find({next[1]}) != b.m_FinalStates.end()) {
-                            result.m_FinalStates.insert(stateCounter);
-                        }
+bool accepts(const DFA & dfa, std::string_view word) {
+    return accepts(asNFA(dfa), word);
+}
 
-                        stateCounter++;
-                    }
+std::string asString(const std::vector<Symbol> & word) {
+    return std::string(word.begin(), word.end());
+}
 
-                    if (pairID.find({transitionA->second, transitionB->second}) == pairID.end()) {
-                        queue.push({transitionA->second, transitionB->second});
-                    }
-                }
-                else {
-                    tempTransitions[{{next[0], next[1]}, symbol}] = {};
-                }
-            }
+//all words over the symbols of at most the given length, shorter words first
+std::vector<std::string> allWords(std::string_view symbols, size_t maxLength) {
+    std::vector<std::string> words = {""};
+    for (size_t i = 0; i < words.size() && words[i].size() < maxLength; i++) {
+        for (char symbol : symbols) {
+            words.push_back(words[i] + symbol);
         }
     }
+    return words;
+}
+
+//the matcher agrees with the simulation of the automaton on every word
+template <typename Automaton, typename Matcher>
+bool agrees(const Automaton & automaton, Matcher && matcher, const std::vector<std::string> & words) {
+    return std::all_of(words.begin(), words.end(), [&](const std::string & word) {
+        return matcher.matches(word) == accepts(automaton, word);
+    });
+}
 
-    for (auto transition : tempTransitions) {
-        result.m_Transitions[{pairID[transition.first.first], transition.first.second}] = pairID[transition.second];
+void writeImage(const std::string & path, const std::vector<uint32_t> & image) {
+    std::unique_ptr<FILE, int (*)(FILE *)> file(std::fopen(path.c_str(), "wb"), std::fclose);
+    size_t written = file ? std::fwrite(image.data(), sizeof(uint32_t), image.size(), file.get()) : 0;
+    assert(written == image.size());
+    (void) written;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+bool mappingRejected(const std::string & path) {
+    try {
+        MappedDFA mapped(path);
+        return false;
+    }
+    catch (const std::runtime_error &) {
+        return true;
     }
+}
+#endif
 
-    return result;
+//equal including the naming of the states, unlike operator==
+bool identical(const DFA & a, const DFA & b) {
+    return std::tie(a.m_States, a.m_Alphabet, a.m_Transitions, a.m_InitialState, a.m_FinalStates)
+            == std::tie(b.m_States, b.m_Alphabet, b.m_Transitions, b.m_InitialState, b.m_FinalStates);
 }
 
-DFA intersect(const NFA& a, const NFA& b) {
-    return minimize(parallelRun(determine(a), determine(b)));
+//the parallel conversions and the alternative algorithms have to number the states exactly like the sequential,
+//eager and Hopcroft based defaults
+void checkConversionVariants(unsigned seed) {
+    std::mt19937 random(seed);
+    ConversionOptions sequential;
+    sequential.m_Threads = 1;
+    sequential.m_Intersection = IntersectionMode::Eager;
+    ConversionOptions parallel;
+    parallel.m_Threads = 4;
+    parallel.m_Intersection = IntersectionMode::Eager;
+    ConversionOptions moore = sequential;
+    moore.m_Minimization = MinimizationAlgorithm::Moore;
+    ConversionOptions onTheFly = sequential;
+    onTheFly.m_Intersection = IntersectionMode::OnTheFly;
+
+    for (int i = 0; i < 50; i++) {
+        unsigned symbols = 2 + random() % 3;
+        NFA a = randomNFA(random, 4 + random() % 10, symbols, 1.5);
+        NFA b = randomNFA(random, 4 + random() % 10, symbols, 1.5);
+        assert(identical(determine(a, sequential), determine(a, parallel)));
+        assert(identical(intersect(a, b, sequential), intersect(a, b, parallel)));
+        assert(identical(unify(a, b, sequential), unify(a, b, parallel)));
+        assert(identical(minimize(determine(a, sequential), sequential), minimize(determine(a, sequential), moore)));
+        assert(identical(intersect(a, b, sequential), intersect(a, b, moore)));
+        assert(identical(unify(a, b, sequential), unify(a, b, moore)));
+        assert(identical(intersect(a, b, sequential), intersect(a, b, onTheFly)));
+    }
 }
 
-#ifndef __PROGTEST__
+//times one operation and prints one JSON object per line: states/sec is measured on the output automaton.
+//the peak RSS is the peak of the whole process so far, not of this operation
+template <typename Operation>
+void benchmark(const char * operation, const std::string & input, size_t inputStates, Operation run) {
+    size_t allocationsBefore = allocationCount.load();
+    auto start = std::chrono::steady_clock::now();
+    size_t outputStates = run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t allocations = allocationCount.load() - allocationsBefore;
 
-// You may need to update this function or the sample data if your state naming strategy differs.
-bool operator==(const DFA& a, const DFA& b)
-{
-    return std::tie(a.m_States, a.m_Alphabet, a.m_Transitions, a.m_InitialState, a.m_FinalStates) == std::tie(b.m_States, b.m_Alphabet, b.m_Transitions, b.m_InitialState, b.m_FinalStates);
+    std::printf("{\"operation\": \"%s\", \"input\": \"%s\", \"input_states\": %zu, \"output_states\": %zu, "
+                "\"seconds\": %.6f, \"states_per_sec\": %.0f, \"allocations\": %zu, \"process_peak_rss_kb\": %ld}\n",
+                operation, input.c_str(), inputStates, outputStates, seconds,
+                seconds > 0 ? outputStates / seconds : 0.0, allocations, processPeakRSS());
+    std::fflush(stdout);
 }
 
-int main()
+//benchmark suite, run with --bench [scale] [seed]. Sizes grow linearly with the scale
+void runBenchmarks(unsigned scale, unsigned seed) {
+    std::mt19937 random(seed);
+
+    for (unsigned n = 8; n <= 10 + 2 * scale; n += 2) {
+        NFA nfa = nthFromEnd(n);
+        std::string input = "nth-from-end-" + std::to_string(n);
+        DFA determined;
+        benchmark("determine", input, nfa.m_States.size(), [&] {
+            determined = determine(nfa);
+            return determined.m_States.size();
+        });
+        benchmark("minimize", input, determined.m_States.size(), [&] {
+            return minimize(determined).m_States.size();
+        });
+    }
+
+    //random NFAs with about one target per symbol are close to the point where subset construction blows up
+    for (State states : {60 * scale, 120 * scale}) {
+        NFA a = randomNFA(random, states, 2, 1.0);
+        NFA b = randomNFA(random, states, 2, 1.0);
+        std::string input = "random-nfa-" + std::to_string(states);
+        DFA determinedA;
+        DFA determinedB;
+        benchmark("determine", input, states, [&] {
+            determinedA = determine(a);
+            determinedB = determine(b);
+            return determinedA.m_States.size() + determinedB.m_States.size();
+        });
+        benchmark("minimize", input, determinedA.m_States.size(), [&] {
+            return minimize(determinedA).m_States.size();
+        });
+        benchmark("parallelRun", input, determinedA.m_States.size() + determinedB.m_States.size(), [&] {
+            return parallelRun(determinedA, determinedB).m_States.size();
+        });
+        benchmark("unify", input, 2 * states, [&] {
+            return unify(a, b).m_States.size();
+        });
+        benchmark("intersect", input, 2 * states, [&] {
+            return intersect(a, b).m_States.size();
+        });
+    }
+
+    //the subsets of large sparse NFAs have to cost time and memory proportional to their own size only
+    for (State length : {10000 * scale, 25000 * scale}) {
+        NFA nfa = laneChain(length);
+        benchmark("determine", "lane-chain-" + std::to_string(nfa.m_States.size()), nfa.m_States.size(), [&] {
+            return determine(nfa).m_States.size();
+        });
+    }
+
+    for (State states : {10000 * scale, 100000 * scale}) {
+        DFA dfa = sparseDFA(random, states, 16, 3);
+        benchmark("minimize", "sparse-dfa-" + std::to_string(states), states, [&] {
+            return minimize(dfa).m_States.size();
+        });
+    }
+}
+
+int main(int argc, char * argv[])
 {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        runBenchmarks(argc > 2 ? std::stoul(argv[2]) : 1, argc > 3 ? std::stoul(argv[3]) : 1);
+        return 0;
+    }
+
     NFA a1{
             {0, 1, 2},
             {'a', 'b'},
@@ -774,6 +4884,261 @@ int main()
 
     DFA hh = unify(h1, h2);
 
+    assert(aa == a);
+    assert(bb == b);
+    assert(cc == c);
+    assert(dd == d);
+
+    std::vector<NFA> as = {a1, a2};
+    std::vector<NFA> bs = {b1, b2};
+    std::vector<NFA> es = {e1, e2, f1, f2};
+    assert(intersectAll(as) == a);
+    assert(unifyAll(bs) == b);
+    assert(unifyAll(es) == unify(unifyNFA(e1, e2), unifyNFA(f1, f2)));
+    assert(intersect(std::move(as[0]), std::move(as[1])) == a);
+
+    assert(combine(a1, a2, BooleanOperation::Intersection) == a);
+    assert(combine(b1, b2, BooleanOperation::Union) == b);
+    assert(complement(difference(a1, a2)) == combine(a1, a2, BooleanOperation::Implication));
+    assert(complement(complement(a1)) == intersect(a1, a1));
+    assert(unify(a1, a2) == complement(product(complement(a1), complement(a2), BooleanOperation::Intersection)));
+
+    //a1 accepts the words ending with "aa", a2 the words starting with "aa"
+    MultiPatternDFA patterns = buildMultiPattern(std::vector<NFA>{a1, a2});
+    assert(patterns.matches("aa") == std::vector<uint32_t>({0, 1}));
+    assert(patterns.matches("aab") == std::vector<uint32_t>({1}));
+    assert(patterns.matches("baa") == std::vector<uint32_t>({0}));
+    assert(patterns.matches("bab").empty());
+    assert(patterns.matches("aac").empty());
+
+    NFA trie{
+            {0, 1, 2, 3, 4},
+            {'a', 'b'},
+            {
+                    {{0, 'a'}, {1}},
+                    {{1, 'b'}, {2}},
+                    {{0, 'b'}, {3}},
+                    {{3, 'b'}, {4}},
+            },
+            0,
+            {1, 2, 4},
+    };
+    IncrementalDFABuilder sortedWords;
+    IncrementalDFABuilder unsortedWords(false);
+    for (auto word : {"a", "ab", "bb"}) {
+        sortedWords.add(word);
+    }
+    for (auto word : {"bb", "a", "ab"}) {
+        unsortedWords.add(word);
+    }
+    assert(sortedWords.finish() == minimize(determine(trie)));
+    assert(unsortedWords.finish() == minimize(determine(trie)));
+
+    //a with its states renamed
+    DFA renamed{
+            {10, 11, 12, 13, 14},
+            {'a', 'b'},
+            {
+                    {{14, 'a'}, {12}},
+                    {{12, 'a'}, {10}},
+                    {{10, 'a'}, {10}},
+                    {{10, 'b'}, {13}},
+                    {{13, 'a'}, {11}},
+                    {{13, 'b'}, {13}},
+                    {{11, 'a'}, {10}},
+                    {{11, 'b'}, {13}},
+            },
+            14,
+            {10},
+    };
+    assert(renamed == a);
+    assert(structuralHash(renamed) == structuralHash(a));
+    assert(structuralHash(aa) == structuralHash(a));
+    assert(!(structuralHash(bb) == structuralHash(a)));
+
+    ConversionCache cache(1 << 20);
+    assert(cache.intersect(a1, a2) == a);
+    assert(cache.intersect(a2, a1) == a);
+    assert(cache.unify(b1, b2) == b);
+    assert(cache.hits() == 1 && cache.misses() == 2);
+
+    QueryResult empty = isEmptyIntersection(a1, a2);
+    assert(!empty.m_Holds);
+    assert(accepts(a1, asString(empty.m_Counterexample)) && accepts(a2, asString(empty.m_Counterexample)));
+    //c is the empty language
+    assert(isEmptyIntersection(c1, c2).m_Holds);
+
+    NFA unified = unifyNFA(b1, b2);
+    assert(isSubset(b1, unified).m_Holds);
+    assert(isSubset(b2, unified).m_Holds);
+    QueryResult subset = isSubset(unified, b1);
+    assert(!subset.m_Holds);
+    assert(accepts(unified, asString(subset.m_Counterexample)) && !accepts(b1, asString(subset.m_Counterexample)));
+
+    assert(areEquivalent(asNFA(minimize(determine(a1))), a1).m_Holds);
+    assert(areEquivalent(asNFA(minimize(determine(h1))), h1).m_Holds);
+    QueryResult equivalent = areEquivalent(a1, a2);
+    assert(!equivalent.m_Holds);
+    assert(accepts(a1, asString(equivalent.m_Counterexample)) != accepts(a2, asString(equivalent.m_Counterexample)));
+
+    //'c' is outside of the alphabet of the samples
+    std::vector<std::string> words = allWords("abc", 7);
+    CompiledDFA compiled(a);
+    assert(compiled.matches("aa") && compiled.matches("aabaa") && compiled.matches("aaabaa"));
+    assert(!compiled.matches("") && !compiled.matches("aab") && !compiled.matches("aaca"));
+    assert(agrees(a, compiled, words));
+    std::vector<std::string_view> views(words.begin(), words.end());
+    std::vector<uint8_t> many = compiled.matchMany(views);
+    for (size_t i = 0; i < words.size(); i++) {
+        assert(many[i] == accepts(a, words[i]));
+    }
+
+    LazyDFAMatcher lazy(a1);
+    assert(lazy.matches("baa") && lazy.matches("abaaa"));
+    assert(!lazy.matches("") && !lazy.matches("aab") && !lazy.matches("aca"));
+    assert(agrees(a1, lazy, words));
+
+    //runs of '0' lead back to the initial subset, so a cache of a few states is flushed after every few bursts
+    //of random symbols. Inputs of random symbols only fill the cache too fast and are simulated on bitsets
+    std::mt19937 random(1);
+    NFA tenthFromEnd = nthFromEnd(10);
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 20; i++) {
+        std::string input;
+        for (int burst = 0; burst < 20; burst++) {
+            input.append(i % 2 == 0 ? 200 : 0, '0');
+            for (int j = 0; j < 10; j++) {
+                input.push_back("01"[random() % 2]);
+            }
+        }
+        inputs.push_back(input);
+    }
+    LazyDFAMatcher flushed(tenthFromEnd, 1024);
+    assert(agrees(tenthFromEnd, flushed, inputs));
+    assert(flushed.flushes() > 0);
+    LazyDFAMatcher cached(tenthFromEnd);
+    assert(agrees(tenthFromEnd, cached, inputs));
+    assert(cached.flushes() == 0);
+
+    SmallNFAMatcher small(a1);
+    assert(small.matches("baa") && !small.matches("aab") && !small.matches("aca"));
+    assert(agrees(a1, small, words));
+    assert(agrees(h1, SmallNFAMatcher(h1), allWords("Gt", 8)));
+    BitParallelNFA<1> bitParallel(toDense(tenthFromEnd));
+    assert(agrees(tenthFromEnd, bitParallel, inputs));
+    //the two wider engines
+    for (unsigned n : {100, 200}) {
+        NFA nthFromEndN = nthFromEnd(n);
+        assert(SmallNFAMatcher::fits(nthFromEndN));
+        SmallNFAMatcher wide(nthFromEndN);
+        assert(agrees(nthFromEndN, wide, inputs));
+        assert(wide.matches("1" + std::string(n - 1, '0')) && !wide.matches("0" + std::string(n - 1, '1')));
+    }
+    assert(!SmallNFAMatcher::fits(nthFromEnd(SmallNFAMatcher::MAX_STATES)));
+
+    //long enough to be split into three chunks of more than 64 KiB on four threads
+    ConversionOptions fourThreads;
+    fourThreads.m_Threads = 4;
+    std::string large(200000, 'a');
+    for (auto & symbol : large) {
+        symbol = "ab"[random() % 2];
+    }
+    large.replace(0, 2, "aa");
+    large.replace(large.size() - 2, 2, "aa");
+    assert(compiled.matchesParallel(large, fourThreads) && compiled.matches(large));
+    large.back() = 'b';
+    assert(!compiled.matchesParallel(large, fourThreads) && !compiled.matches(large));
+    large[large.size() / 2] = 'c';
+    large.back() = 'a';
+    assert(!compiled.matchesParallel(large, fourThreads));
+
+    CompiledDFA tenthFromEndDFA(determine(tenthFromEnd));
+    for (auto & symbol : large) {
+        symbol = "01"[random() % 2];
+    }
+    for (char tenth : {'0', '1'}) {
+        large[large.size() - 10] = tenth;
+        assert(tenthFromEndDFA.matchesParallel(large, fourThreads) == (tenth == '1'));
+        assert(tenthFromEndDFA.matches(large) == (tenth == '1'));
+    }
+
+    //every word fed in chunks of 1, 2 and 3 bytes is accepted iff it matches as a whole
+    StreamMatcher stream(compiled);
+    for (size_t chunk = 1; chunk <= 3; chunk++) {
+        for (auto & word : words) {
+            stream.reset();
+            for (size_t offset = 0; offset < word.size(); offset += chunk) {
+                stream.feed(std::string_view(word).substr(offset, chunk));
+            }
+            assert(stream.accepting() == compiled.matches(word));
+        }
+    }
+    stream.reset();
+    assert(stream.feed("aa") && stream.feed("ba") && !stream.accepting());
+    assert(stream.feed("a") && stream.accepting() && stream.consumed() == 5);
+    //no word starting with b is accepted, the rest of the stream is ignored
+    stream.reset();
+    assert(!stream.feed("ab") && stream.dead());
+    assert(!stream.feed("aa") && !stream.accepting() && stream.consumed() == 2);
+    stream.reset();
+    std::vector<uint8_t> bytes = {'a', 'a', 'b', 'a', 'a'};
+    assert(stream.feed(bytes.data(), 2) && stream.feed(bytes.data() + 2, 3) && stream.accepting());
+
+#if defined(__unix__) || defined(__APPLE__)
+    //the image of the sample DFA survives the round trip through a file
+    std::string path = (std::filesystem::temp_directory_path() / ("automata-" + std::to_string(::getpid()) + ".dfa")).string();
+    saveMatcher(compiled, path);
+    {
+        MappedDFA mapped(path);
+        assert(mapped.verify() && mapped.bytes() == compiled.image().size() * sizeof(uint32_t));
+        assert(mapped.matches("aabaa") && !mapped.matches("aab"));
+        assert(agrees(a, mapped, words));
+    }
+
+    std::vector<uint32_t> image = compiled.image();
+    writeImage(path, std::vector<uint32_t>(image.begin(), image.end() - 1));
+    assert(mappingRejected(path));
+    std::vector<uint32_t> swapped = image;
+    for (auto & word : swapped) {
+        word = __builtin_bswap32(word);
+    }
+    writeImage(path, swapped);
+    assert(mappingRejected(path));
+    //a transition out of the table passes the header check, but not verify()
+    image.back() = image.size();
+    writeImage(path, image);
+    assert(!MappedDFA(path).verify());
+    std::remove(path.c_str());
+#endif
+
+    ConversionOptions limited;
+    limited.m_Budget.m_MaxStates = 1000;
+    BudgetedResult<DFA> exceeded = determineBudgeted(nthFromEnd(20), limited);
+    assert(exceeded.m_Status == ConversionStatus::StateLimitExceeded);
+    assert(!exceeded.m_Result && exceeded.m_States > 1000);
+    BudgetedResult<DFA> completed = intersectBudgeted(a1, a2, limited);
+    assert(completed.m_Status == ConversionStatus::Completed && *completed.m_Result == a);
+
+    std::atomic<bool> cancel{true};
+    ConversionOptions cancelled;
+    cancelled.m_Budget.m_Cancel = &cancel;
+    BudgetedResult<DFA> stopped = determineBudgeted(nthFromEnd(20), cancelled);
+    assert(stopped.m_Status == ConversionStatus::Cancelled);
+    assert(!stopped.m_Result && stopped.m_States == 1);
+    assert(unifyBudgeted(b1, b2, cancelled).m_Status == ConversionStatus::Cancelled);
+    assert(intersectBudgeted(a1, a2, cancelled).m_Status == ConversionStatus::Cancelled);
+
+#ifdef AUTOMATA_STATS
+    //the empty result has no sink block to drop, the result of a1 and a2 drops one
+    ConversionStats stats;
+    ConversionOptions counted;
+    counted.m_Stats = &stats;
+    assert(intersect(c1, c2, counted) == c && stats.m_SinkRemovals == 0);
+    assert(intersect(a1, a2, counted) == a && stats.m_SinkRemovals == 1);
+#endif
+
+    checkConversionVariants(1);
+
     return 0;
 }
 #endif